@@ -0,0 +1,375 @@
+#pragma once
+#include <MySensorsCommon.h>
+
+// Compile-time configured relay + sensor groups.
+//
+// A node declares each group as a type, e.g.
+//
+//   typedef ControlGroup<Relay<2, 3, RelayMode::Pulse>, DoorSensor<1, 2>> Door1;
+//   Door1 door1;
+//   typedef ControlGroups<ControlGroupRef<Door1, door1>, ...> Groups;
+//
+// and forwards setup/presentation/loop/receive to Groups. Incoming messages are routed through a
+// table in flash indexed by child ID, so routing cost does not depend on the number of groups.
+// None of the classes has virtual functions; a group takes exactly the RAM of its state.
+
+static constexpr uint8_t NoPin = 0xFF;
+
+enum class RelayMode : uint8_t {
+    // Holds the commanded state, which is restored from EEPROM at boot
+    Latch,
+    // Closes for PulseMillis on an ON command, e.g. to push a door opener button
+    Pulse
+};
+
+// Start time of a pulse. Only pulse relays have one; the empty base of a latched relay takes no RAM.
+template <RelayMode Mode>
+class RelayPulseTimer {
+  protected:
+    void _startPulse() {}
+
+    bool _pulseElapsed(uint16_t) const {
+        return false;
+    }
+};
+
+template <>
+class RelayPulseTimer<RelayMode::Pulse> {
+  private:
+    unsigned long _pulseStartMillis = 0;
+
+  protected:
+    void _startPulse() {
+        this->_pulseStartMillis = ::millis();
+    }
+
+    bool _pulseElapsed(uint16_t pulseMillis) const {
+        return ::millis() - this->_pulseStartMillis >= pulseMillis;
+    }
+};
+
+template <uint8_t Id, uint8_t Pin, RelayMode Mode = RelayMode::Latch, uint8_t OnLevel = LOW, uint8_t IndicatorPin = NoPin, uint16_t PulseMillis = 200>
+class Relay : private RelayPulseTimer<Mode> {
+  private:
+    bool _state = false;
+
+    void _write(bool state) {
+        ::digitalWrite(Pin, state ? OnLevel : !OnLevel);
+        if (IndicatorPin != NoPin) {
+            ::digitalWrite(IndicatorPin, state ? HIGH : LOW);
+        }
+    }
+
+  public:
+    static constexpr uint8_t ChildId = Id;
+
+    void setup() {
+        ::pinMode(Pin, OUTPUT);
+        if (IndicatorPin != NoPin) {
+            ::pinMode(IndicatorPin, OUTPUT);
+        }
+        // Set relay to last known state (using eeprom storage)
+        this->_state = Mode == RelayMode::Latch && ::loadState(Id);
+        this->_write(this->_state);
+    }
+
+    void present() {
+        ::present(Id, S_LIGHT);
+    }
+
+    bool state() const {
+        return this->_state;
+    }
+
+    void set(bool state) {
+        this->_state = state;
+        this->_write(state);
+        if (Mode == RelayMode::Latch) {
+            // Store state in eeprom
+            ::saveState(Id, state);
+        } else if (state) {
+            this->_startPulse();
+        }
+        Serial.print("Set relay with sensor ID:");
+        Serial.print(Id);
+        Serial.print(", New status: ");
+        Serial.println(state);
+    }
+
+    bool receive(const MyMessage &message) {
+        if (message.type != V_LIGHT) {
+            return false;
+        }
+        this->set(message.getBool());
+        // A latched relay confirms its new state; a pulse is over before it could be reported
+        if (Mode == RelayMode::Latch) {
+            this->sendState();
+        }
+        return true;
+    }
+
+    // Releases a pulse without blocking; returns true if a message was sent
+    bool update() {
+        if (Mode == RelayMode::Pulse && this->_state && this->_pulseElapsed(PulseMillis)) {
+            this->set(false);
+        }
+        return false;
+    }
+
+    bool sendState() {
+        MyMessage msg(Id, V_LIGHT);
+        return ::send(msg.set(this->_state));
+    }
+};
+
+// Contact sensor reported as S_DOOR/V_TRIPPED. Changes are captured by the pin change interrupt
+// (forwarded by the sketch's ISR to onPinChange()) and reported once the level has been stable
+// for DebounceMillis.
+template <uint8_t Id, uint8_t Pin, uint8_t OpenLevel = HIGH, uint16_t DebounceMillis = 50>
+class DoorSensor {
+  private:
+    bool _reportedState = false;
+    // Written by the pin change ISR
+    volatile bool _state = false;
+    volatile bool _changed = false;
+    volatile unsigned long _changedMillis = 0;
+    // Input register and bit of the pin, looked up once so the ISR does not need digitalRead()
+    volatile uint8_t *_input = nullptr;
+    uint8_t _mask = 0;
+
+    bool _read() {
+        return ((*this->_input & this->_mask) ? HIGH : LOW) == OpenLevel;
+    }
+
+  public:
+    static constexpr uint8_t ChildId = Id;
+
+    void setup() {
+        ::pinMode(Pin, INPUT);
+        this->_input = portInputRegister(digitalPinToPort(Pin));
+        this->_mask = digitalPinToBitMask(Pin);
+
+        // Report the initial state once it has been stable for the debounce time
+        this->_state = this->_read();
+        this->_changedMillis = ::millis();
+        this->_changed = true;
+
+        // Enable the pin change interrupt of the sensor pin
+        *digitalPinToPCMSK(Pin) |= bit(digitalPinToPCMSKbit(Pin));
+        PCIFR |= bit(digitalPinToPCICRbit(Pin));
+        PCICR |= bit(digitalPinToPCICRbit(Pin));
+    }
+
+    void present() {
+        ::present(Id, S_DOOR);
+    }
+
+    bool state() const {
+        return this->_reportedState;
+    }
+
+    // Called from the pin change ISR, which is shared by all pins of a port
+    void onPinChange() {
+        bool state = this->_read();
+        if (state != this->_state) {
+            this->_state = state;
+            this->_changedMillis = ::millis();
+            this->_changed = true;
+        }
+    }
+
+    // Reports a settled change; returns true if a message was sent
+    bool update() {
+        noInterrupts();
+        bool settled = this->_changed && ::millis() - this->_changedMillis >= DebounceMillis;
+        if (settled) {
+            this->_changed = false;
+        }
+        bool state = this->_state;
+        interrupts();
+
+        if (!settled || state == this->_reportedState) {
+            return false;
+        }
+        this->_reportedState = state;
+        this->sendState();
+        return true;
+    }
+
+    bool sendState() {
+        MyMessage msg(Id, V_TRIPPED);
+        Serial.print("Sending state for sensor ID: ");
+        Serial.print(Id);
+        Serial.print(", Value: ");
+        Serial.println(this->_reportedState);
+        return ::send(msg.set(this->_reportedState));
+    }
+};
+
+// Placeholder for groups with a relay only
+class NoSensor {
+  public:
+    void setup() {}
+    void present() {}
+    void onPinChange() {}
+    bool update() { return false; }
+    bool sendState() { return true; }
+};
+
+// NoSensor is an empty base, so a relay-only group costs nothing on top of its relay
+template <class RelayType, class SensorType = NoSensor>
+class ControlGroup : private RelayType, private SensorType {
+  public:
+    static constexpr uint8_t ChildId = RelayType::ChildId;
+
+    RelayType &relay() {
+        return *this;
+    }
+
+    SensorType &sensor() {
+        return *this;
+    }
+
+    void setup() {
+        RelayType::setup();
+        SensorType::setup();
+    }
+
+    void present() {
+        RelayType::present();
+        SensorType::present();
+    }
+
+    void receive(const MyMessage &message) {
+        RelayType::receive(message);
+    }
+
+    void onPinChange() {
+        SensorType::onPinChange();
+    }
+
+    bool update() {
+        bool sent = RelayType::update();
+        return SensorType::update() || sent;
+    }
+
+    bool sendState() {
+        bool success = RelayType::sendState();
+        return SensorType::sendState() && success;
+    }
+};
+
+// Binds a group type to its global instance so the dispatch table can call it without a pointer
+template <class Group, Group &Instance>
+struct ControlGroupRef {
+    static constexpr uint8_t ChildId = Group::ChildId;
+
+    static void setup() { Instance.setup(); }
+    static void present() { Instance.present(); }
+    static void receive(const MyMessage &message) { Instance.receive(message); }
+    static void onPinChange() { Instance.onPinChange(); }
+    static bool update() { return Instance.update(); }
+    static bool sendState() { return Instance.sendState(); }
+};
+
+typedef void (*ControlGroupHandler)(const MyMessage &);
+
+template <uint8_t... Ids>
+struct ChildIdSequence {};
+
+template <uint8_t Count, uint8_t... Ids>
+struct MakeChildIdSequence : MakeChildIdSequence<Count - 1, Count - 1, Ids...> {};
+
+template <uint8_t... Ids>
+struct MakeChildIdSequence<0, Ids...> {
+    typedef ChildIdSequence<Ids...> Type;
+};
+
+template <class... Refs>
+struct MaxChildId {
+    static constexpr uint8_t Value = 0;
+};
+
+template <class First, class... Rest>
+struct MaxChildId<First, Rest...> {
+    static constexpr uint8_t Value = First::ChildId > MaxChildId<Rest...>::Value ? First::ChildId : MaxChildId<Rest...>::Value;
+};
+
+template <uint8_t Id, class... Refs>
+struct ChildHandler {
+    static constexpr ControlGroupHandler Value = nullptr;
+};
+
+template <uint8_t Id, class First, class... Rest>
+struct ChildHandler<Id, First, Rest...> {
+    static constexpr ControlGroupHandler Value = First::ChildId == Id ? &First::receive : ChildHandler<Id, Rest...>::Value;
+};
+
+template <class Sequence, class... Refs>
+struct ControlGroupTable;
+
+template <uint8_t... Ids, class... Refs>
+struct ControlGroupTable<ChildIdSequence<Ids...>, Refs...> {
+    static const ControlGroupHandler Handlers[sizeof...(Ids)];
+};
+
+template <uint8_t... Ids, class... Refs>
+const ControlGroupHandler ControlGroupTable<ChildIdSequence<Ids...>, Refs...>::Handlers[sizeof...(Ids)] PROGMEM = {
+    ChildHandler<Ids, Refs...>::Value...
+};
+
+template <class... Refs>
+class ControlGroups {
+  private:
+    static constexpr uint8_t TableSize = MaxChildId<Refs...>::Value + 1;
+    typedef ControlGroupTable<typename MakeChildIdSequence<TableSize>::Type, Refs...> Table;
+
+  public:
+    static void setup() {
+        int expand[] = {0, (Refs::setup(), 0)...};
+        (void)expand;
+    }
+
+    static void present() {
+        int expand[] = {0, (Refs::present(), ::wait(40), 0)...};
+        (void)expand;
+    }
+
+    // Call from the pin change ISR(s)
+    static void onPinChange() {
+        int expand[] = {0, (Refs::onPinChange(), 0)...};
+        (void)expand;
+    }
+
+    // Call from loop(); returns true if any group sent a message
+    static bool update() {
+        bool results[] = {false, Refs::update()...};
+        bool sent = false;
+        for (bool result : results) {
+            sent = sent || result;
+        }
+        return sent;
+    }
+
+    static bool sendState() {
+        bool results[] = {true, Refs::sendState()...};
+        bool success = true;
+        for (bool result : results) {
+            success = success && result;
+        }
+        return success;
+    }
+
+    // Routes a message to the group owning its child ID; returns false if there is none
+    static bool receive(const MyMessage &message) {
+        if (message.sensor >= TableSize) {
+            return false;
+        }
+        ControlGroupHandler handler = reinterpret_cast<ControlGroupHandler>(pgm_read_ptr(&Table::Handlers[message.sensor]));
+        if (handler == nullptr) {
+            return false;
+        }
+        handler(message);
+        return true;
+    }
+};
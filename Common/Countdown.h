@@ -0,0 +1,63 @@
+#pragma once
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#endif
+
+// Countdown against an absolute deadline.
+//
+// The remaining time is always derived from the deadline and the current time, never decremented,
+// so late or skipped calls do not add up to drift. The current time is passed in by the caller,
+// which keeps this free of Arduino dependencies and lets it run on simulated time on the host.
+// Times are 32 bit like millis() on AVR, also on the host, and deadlines are compared with a signed
+// difference, so they work across the millis() overflow as long as the countdown is shorter than
+// 24 days.
+class Countdown {
+  private:
+    uint32_t _deadlineMillis = 0;
+    bool _running = false;
+
+    int32_t _left(uint32_t now) const {
+        return (int32_t)(this->_deadlineMillis - now);
+    }
+
+  public:
+    void start(uint32_t now, uint32_t seconds) {
+        this->_deadlineMillis = now + seconds * (uint32_t)1000;
+        this->_running = true;
+    }
+
+    void stop() {
+        this->_running = false;
+    }
+
+    bool running() const {
+        return this->_running;
+    }
+
+    // Returns true once, on the first call at or after the deadline, and stops the countdown
+    bool expired(uint32_t now) {
+        if (!this->_running || this->_left(now) > 0) {
+            return false;
+        }
+        this->_running = false;
+        return true;
+    }
+
+    uint32_t remainingMillis(uint32_t now) const {
+        int32_t left = this->_left(now);
+        return this->_running && left > 0 ? left : 0;
+    }
+
+    // Rounded up, so a countdown shows its full length when started and 0 only when it expires
+    uint32_t remainingSeconds(uint32_t now) const {
+        return (this->remainingMillis(now) + 999) / 1000;
+    }
+
+    uint32_t remainingMinutes(uint32_t now) const {
+        return (this->remainingMillis(now) + 59999) / 60000;
+    }
+
+    ~Countdown() {}
+};
@@ -30,6 +30,27 @@ class DimmerSensor : public ISensor
         }
 
         bool report() {
+            return false;
+        }
+
+        bool handles(uint8_t childId) {
+            return childId == this->_sensorId;
+        }
+
+        bool receive(const MyMessage &message) {
+            if (message.type != V_PERCENTAGE) {
+                return false;
+            }
+            uint8_t value = message.getByte();
+            Serial.print("Incoming dimmer value: ");
+            Serial.println(value);
+            this->set(this->coerce(value));
+            return true;
+        }
+
+        // Override to limit the percentages accepted from the controller
+        virtual uint8_t coerce(uint8_t percentage) {
+            return percentage;
         }
 
         uint8_t read() {
@@ -0,0 +1,200 @@
+#pragma once
+#include <MySensorsCommon.h>
+
+// Relay that cycles on and off on its own, e.g. a pump running 7 minutes out of every 30.
+//
+// The schedule runs entirely on the node, so the relay keeps cycling while the radio or the
+// controller is down. The controller can tune it through the relay's child ID:
+// - V_VAR1 / V_VAR2 set the on / off time in minutes; they are kept in EEPROM (saveState) and take
+//   effect in the current phase. An on time of 0 keeps the relay off, an off time of 0 keeps it on
+// - V_STATUS starts an on (1) or off (0) phase right away, after which the schedule carries on
+// Phases are timed from the end of the previous one, not from when loop() noticed it, so the
+// schedule does not drift. State changes are reported as V_STATUS; a report that does not reach the
+// parent is retried with a doubling delay instead of blocking loop() with retries.
+template <uint8_t OnLevel = LOW>
+class DutyCycleRelay : public ISensor {
+  private:
+    static constexpr unsigned long MinRetryInterval = 1000;
+    static constexpr unsigned long MaxRetryInterval = 300000;
+    static constexpr uint8_t ReportState = 1;
+    static constexpr uint8_t ReportOnMinutes = 2;
+    static constexpr uint8_t ReportOffMinutes = 4;
+
+    uint8_t _pin;
+    uint8_t _childId;
+    uint8_t _firstPosition;
+    uint16_t _onMinutes;
+    uint16_t _offMinutes;
+    bool _state = false;
+    unsigned long _phaseStartMillis = 0;
+    uint8_t _pendingReports = 0;
+    unsigned long _retryInterval = 0;
+    unsigned long _lastAttemptMillis = 0;
+
+    static uint8_t _checksum(uint16_t onMinutes, uint16_t offMinutes) {
+        return ~(uint8_t)(onMinutes + (onMinutes >> 8) + offMinutes + (offMinutes >> 8));
+    }
+
+    void _load() {
+        uint16_t onMinutes = ::loadState(this->_firstPosition) | ::loadState(this->_firstPosition + 1) << 8;
+        uint16_t offMinutes = ::loadState(this->_firstPosition + 2) | ::loadState(this->_firstPosition + 3) << 8;
+        // Erased or torn EEPROM fails the checksum and leaves the defaults in place
+        if (::loadState(this->_firstPosition + 4) == DutyCycleRelay::_checksum(onMinutes, offMinutes)) {
+            this->_onMinutes = onMinutes;
+            this->_offMinutes = offMinutes;
+        }
+    }
+
+    void _save() {
+        ::saveState(this->_firstPosition, this->_onMinutes);
+        ::saveState(this->_firstPosition + 1, this->_onMinutes >> 8);
+        ::saveState(this->_firstPosition + 2, this->_offMinutes);
+        ::saveState(this->_firstPosition + 3, this->_offMinutes >> 8);
+        ::saveState(this->_firstPosition + 4, DutyCycleRelay::_checksum(this->_onMinutes, this->_offMinutes));
+    }
+
+    unsigned long _phaseMillis() const {
+        return (this->_state ? this->_onMinutes : this->_offMinutes) * 60000UL;
+    }
+
+    // A phase of length 0 is skipped, unless both are, which keeps the relay off
+    bool _skip(bool state) const {
+        return state ? this->_onMinutes == 0 : this->_offMinutes == 0 && this->_onMinutes != 0;
+    }
+
+    void _write(bool state) {
+        if (state != this->_state) {
+            this->_state = state;
+            this->_queueReport(ReportState);
+        }
+        ::digitalWrite(this->_pin, state ? OnLevel : !OnLevel);
+    }
+
+    void _startPhase(bool state, unsigned long startMillis) {
+        if (this->_skip(state)) {
+            state = !state;
+        }
+        this->_phaseStartMillis = startMillis;
+        this->_write(state);
+    }
+
+    void _queueReport(uint8_t reports) {
+        this->_pendingReports |= reports;
+        this->_retryInterval = 0;
+    }
+
+    bool _send(uint8_t type, uint16_t value) {
+        MyMessage msg(this->_childId, type);
+        return ::send(msg.set(value));
+    }
+
+  public:
+    DutyCycleRelay(uint8_t pin, uint8_t childId, uint8_t firstPosition, uint16_t onMinutes, uint16_t offMinutes)
+        : _pin(pin), _childId(childId), _firstPosition(firstPosition), _onMinutes(onMinutes), _offMinutes(offMinutes) {}
+
+    // Occupies 5 bytes of the user EEPROM area from firstPosition
+    void setup() {
+        this->_load();
+        ::pinMode(this->_pin, OUTPUT);
+        // Every boot starts with an on phase
+        this->_state = false;
+        this->_startPhase(true, ::millis());
+        this->_queueReport(ReportState | ReportOnMinutes | ReportOffMinutes);
+    }
+
+    void present() {
+        ::present(this->_childId, S_BINARY, "Duty cycle");
+        ::wait(40);
+    }
+
+    bool handles(uint8_t childId) {
+        return childId == this->_childId;
+    }
+
+    bool receive(const MyMessage &message) {
+        if (message.isAck()) {
+            return false;
+        }
+        switch (message.type) {
+            case V_STATUS:
+                this->_startPhase(message.getBool(), ::millis());
+                // Confirm even if the state did not change
+                this->_queueReport(ReportState);
+                return true;
+            case V_VAR1:
+                this->_onMinutes = message.getUInt();
+                break;
+            case V_VAR2:
+                this->_offMinutes = message.getUInt();
+                break;
+            default:
+                return false;
+        }
+        Serial.print("Duty cycle: ");
+        Serial.print(this->_onMinutes);
+        Serial.print(" min on, ");
+        Serial.print(this->_offMinutes);
+        Serial.println(" min off");
+        this->_save();
+        // The new times apply to the running phase; one that is now skipped ends at once and one
+        // that is over ends in report()
+        if (this->_skip(this->_state)) {
+            this->_startPhase(!this->_state, ::millis());
+        }
+        this->_queueReport(ReportOnMinutes | ReportOffMinutes);
+        return true;
+    }
+
+    bool state() const {
+        return this->_state;
+    }
+
+    // Call from loop(); switches phases when due and sends pending reports, returns true if one was sent
+    bool report() {
+        unsigned long now = ::millis();
+        // Unsigned subtraction keeps this correct across the millis() rollover
+        if (!this->_skip(!this->_state) && now - this->_phaseStartMillis >= this->_phaseMillis()) {
+            unsigned long phaseEnd = this->_phaseStartMillis + this->_phaseMillis();
+            unsigned long nextPhaseMillis = (this->_state ? this->_offMinutes : this->_onMinutes) * 60000UL;
+            // Start afresh instead of catching up on phases that were missed as a whole, e.g. after
+            // the times were shortened, so the relay does not chatter
+            this->_startPhase(!this->_state, now - phaseEnd < nextPhaseMillis ? phaseEnd : now);
+        }
+
+        if (this->_pendingReports == 0 || now - this->_lastAttemptMillis < this->_retryInterval) {
+            return false;
+        }
+        this->_lastAttemptMillis = now;
+        bool sent = true;
+        if (this->_pendingReports & ReportState) {
+            sent = this->_send(V_STATUS, this->_state);
+            if (sent) {
+                this->_pendingReports &= ~ReportState;
+            }
+        }
+        if (sent && (this->_pendingReports & ReportOnMinutes)) {
+            sent = this->_send(V_VAR1, this->_onMinutes);
+            if (sent) {
+                this->_pendingReports &= ~ReportOnMinutes;
+            }
+        }
+        if (sent && (this->_pendingReports & ReportOffMinutes)) {
+            sent = this->_send(V_VAR2, this->_offMinutes);
+            if (sent) {
+                this->_pendingReports &= ~ReportOffMinutes;
+            }
+        }
+        if (sent) {
+            this->_retryInterval = 0;
+        } else {
+            this->_retryInterval = constrain(this->_retryInterval * 2, MinRetryInterval, MaxRetryInterval);
+            #ifdef MY_DEBUG
+            Serial.print("Report failed, retrying in ");
+            Serial.println(this->_retryInterval);
+            #endif
+        }
+        return true;
+    }
+
+    ~DutyCycleRelay() {}
+};
@@ -0,0 +1,192 @@
+#pragma once
+#include <MySensorsCommon.h>
+
+// Temperature controlled 4-pin PC fan.
+//
+// The fan is driven by a 25 kHz PWM from Timer2 on OC2B (pin 3), as in PwmFanControl, and its tach
+// output is timed by the Timer1 input capture on ICP1 (pin 8). The sketch forwards
+// ISR(TIMER1_CAPT_vect) to onCapture(). Timer1 and Timer2 are taken over completely.
+//
+// Two cascaded integer control loops run the fan only as fast as the temperature requires:
+// - a PI loop turns each new temperature (setTemperature()) into a target speed, in tenths of a
+//   degree and RPM so no floats are involved
+// - every ControlInterval an integral loop adjusts the duty cycle until the tach reads the target
+//   speed, which also compensates for fans that need a different duty cycle for the same speed
+// A fan that stalls while it is driven is kicked with full duty until it turns again.
+// Duty (V_PERCENTAGE) and speed (V_VAR1) are reported through the fan's child ID.
+class FanController : public ISensor {
+  private:
+    static constexpr uint8_t PwmTop = F_CPU / 8 / 25000 - 1; // 79 at 16 MHz
+    static constexpr uint8_t MinDuty = PwmTop / 5; // Most fans do not turn reliably below 20%
+    static constexpr uint8_t PwmPin = 3; // OC2B
+    static constexpr uint8_t TachPin = 8;
+    static constexpr uint8_t PulsesPerRevolution = 2;
+    static constexpr uint32_t TachTicksPerMinute = F_CPU / 64 * 60;
+    // The capture timer wraps after 262 ms at 16 MHz; a longer gap between pulses means the fan stopped
+    static constexpr unsigned long StallMillis = 250;
+    static constexpr unsigned long ControlInterval = 250;
+    static constexpr unsigned long ReportInterval = 30000;
+    // Target speed per tenth of a degree above the set point, and per tenth degree and update of its integral
+    static constexpr int16_t ProportionalGain = 20;
+    static constexpr int16_t IntegralGain = 2;
+    static constexpr int32_t IntegralLimit = 10000;
+    // Fan stops this many tenths of a degree below the set point
+    static constexpr int16_t Hysteresis = 20;
+    // Duty cycle change per RPM of speed error and control interval, in 1/256 duty steps
+    static constexpr int16_t SpeedGain = 2;
+
+    uint8_t _childId;
+    MessageSender _messageSender;
+    int16_t _setPoint;
+    uint16_t _minRpm;
+    uint16_t _maxRpm;
+    int32_t _integral = 0;
+    uint16_t _targetRpm = 0;
+    uint16_t _rpm = 0;
+    int32_t _duty = 0; // Duty cycle in 1/256 steps of OCR2B
+    unsigned long _lastControlMillis = 0;
+    unsigned long _lastReportMillis = 0;
+
+    // Written by the input capture ISR
+    volatile uint16_t _lastCapture = 0;
+    volatile unsigned long _lastCaptureMillis = 0;
+    volatile uint32_t _periodSum = 0;
+    volatile uint8_t _periodCount = 0;
+
+    // 25 kHz fast PWM on OC2B with OCR2A as top
+    static void _pwmBegin() {
+        // OC2B only reaches the pin when it is an output; otherwise the fan's PWM input floats
+        ::pinMode(PwmPin, OUTPUT);
+        TCCR2A = 0;
+        TCCR2B = 0;
+        TIMSK2 = 0;
+        TIFR2 = 0;
+        TCCR2A |= (1 << COM2B1) | (1 << WGM21) | (1 << WGM20);
+        TCCR2B |= (1 << WGM22) | (1 << CS21); // prescaler 8
+        OCR2A = PwmTop;
+        OCR2B = 0;
+    }
+
+    static void _pwmDuty(uint8_t ocrb) {
+        OCR2B = ocrb;
+    }
+
+    // Timer1 counting at F_CPU / 64, capturing falling edges of the tach with the noise canceler on
+    static void _tachBegin() {
+        ::pinMode(TachPin, INPUT_PULLUP);
+        TCCR1A = 0;
+        TCCR1B = (1 << ICNC1) | (1 << CS11) | (1 << CS10);
+        TIFR1 = (1 << ICF1);
+        TIMSK1 = (1 << ICIE1);
+    }
+
+    // Average speed since the last call
+    uint16_t _readRpm() {
+        noInterrupts();
+        uint32_t periodSum = this->_periodSum;
+        uint8_t periodCount = this->_periodCount;
+        bool stalled = ::millis() - this->_lastCaptureMillis >= StallMillis;
+        this->_periodSum = 0;
+        this->_periodCount = 0;
+        interrupts();
+        if (stalled || periodCount == 0) {
+            return stalled ? 0 : this->_rpm;
+        }
+        return TachTicksPerMinute / PulsesPerRevolution * periodCount / periodSum;
+    }
+
+    void _control() {
+        this->_rpm = this->_readRpm();
+        if (this->_targetRpm == 0) {
+            this->_duty = 0;
+        } else if (this->_rpm == 0) {
+            // Not turning (yet), kick it with full duty
+            this->_duty = (int32_t)PwmTop << 8;
+        } else {
+            this->_duty += ((int32_t)this->_targetRpm - this->_rpm) * SpeedGain;
+            this->_duty = constrain(this->_duty, (int32_t)MinDuty << 8, (int32_t)PwmTop << 8);
+        }
+        FanController::_pwmDuty(this->_duty >> 8);
+    }
+
+  public:
+    // setPoint in degrees Celsius; the fan runs between minRpm and maxRpm while above it
+    FanController(uint8_t childId, MessageSender messageSender, float setPoint, uint16_t minRpm, uint16_t maxRpm)
+        : _childId(childId), _messageSender(messageSender), _setPoint(setPoint * 10), _minRpm(minRpm), _maxRpm(maxRpm) {}
+
+    void setup() {
+        FanController::_pwmBegin();
+        FanController::_tachBegin();
+    }
+
+    void present() {
+        ::present(this->_childId, S_CUSTOM, "Fan");
+        ::wait(40);
+    }
+
+    // Call from ISR(TIMER1_CAPT_vect)
+    void onCapture() {
+        uint16_t capture = ICR1;
+        unsigned long now = ::millis();
+        if (now - this->_lastCaptureMillis < StallMillis && this->_periodCount < 255) {
+            this->_periodSum += (uint16_t)(capture - this->_lastCapture);
+            this->_periodCount++;
+        }
+        this->_lastCapture = capture;
+        this->_lastCaptureMillis = now;
+    }
+
+    // Feeds a new temperature reading in degrees Celsius to the PI loop; NAN (a failed reading) runs
+    // the fan at full speed
+    void setTemperature(float temperature) {
+        if (isnan(temperature)) {
+            this->_targetRpm = this->_maxRpm;
+            return;
+        }
+        int16_t error = (int16_t)(temperature * 10) - this->_setPoint;
+        int32_t target = (int32_t)error * ProportionalGain + this->_integral * IntegralGain;
+        // Only integrate while that moves the target back into range (anti-windup)
+        if ((target < this->_maxRpm || error < 0) && (target > this->_minRpm || error > 0)) {
+            this->_integral = constrain(this->_integral + error, -IntegralLimit, IntegralLimit);
+        }
+        if (error < -Hysteresis || (this->_targetRpm == 0 && error < 0)) {
+            this->_targetRpm = 0;
+        } else {
+            this->_targetRpm = constrain(target, (int32_t)this->_minRpm, (int32_t)this->_maxRpm);
+        }
+    }
+
+    uint16_t rpm() const {
+        return this->_rpm;
+    }
+
+    uint8_t dutyPercent() const {
+        return (this->_duty >> 8) * 100 / PwmTop;
+    }
+
+    // Runs the speed loop; reports duty and speed every ReportInterval and returns true then
+    bool report() {
+        unsigned long now = ::millis();
+        if (now - this->_lastControlMillis >= ControlInterval) {
+            this->_lastControlMillis = now;
+            this->_control();
+        }
+        if (now - this->_lastReportMillis < ReportInterval) {
+            return false;
+        }
+        this->_lastReportMillis = now;
+
+        Serial.print("Fan: ");
+        Serial.print(this->dutyPercent());
+        Serial.print("%, ");
+        Serial.print(this->_rpm);
+        Serial.println(" RPM");
+        MyMessage dutyMsg(this->_childId, V_PERCENTAGE);
+        this->_messageSender.send(dutyMsg.set(this->dutyPercent()));
+        MyMessage rpmMsg(this->_childId, V_VAR1);
+        this->_messageSender.send(rpmMsg.set(this->_rpm));
+        return true;
+    }
+
+    ~FanController() {}
+};
@@ -0,0 +1,66 @@
+#pragma once
+#ifdef ARDUINO
+#include <MySensorsCommon.h>
+#endif
+
+// Adaptive heartbeat scheduler.
+// Any message the node sends already tells the controller that the node is alive, so call
+// notifySent() after each send to push the next heartbeat back. Every heartbeat that reaches the
+// parent doubles the interval up to the maximum; a failed one drops it back to the minimum.
+// Host builds provide millis() and sendHeartbeat() before including this, see
+// extras/HeartbeatSimulation.cpp.
+class Heartbeat {
+  public:
+    // Sends the heartbeat and returns whether it reached the parent node
+    typedef bool (*Action)();
+
+  private:
+    unsigned long _minInterval;
+    unsigned long _maxInterval;
+    unsigned long _interval;
+    unsigned long _lastActivityMillis = 0;
+    Action _action;
+
+    static bool _sendHeartbeat() {
+        return ::sendHeartbeat();
+    }
+
+  public:
+    Heartbeat(unsigned long minInterval, unsigned long maxInterval, Action action = Heartbeat::_sendHeartbeat)
+        : _minInterval(minInterval), _maxInterval(maxInterval), _interval(minInterval), _action(action) {}
+
+    void notifySent() {
+        this->_lastActivityMillis = ::millis();
+    }
+
+    // Fall back to the minimum interval, e.g. after the node lost its parent
+    void reset() {
+        this->_interval = this->_minInterval;
+    }
+
+    unsigned long interval() const {
+        return this->_interval;
+    }
+
+    // Call from loop(); returns true if a heartbeat was sent
+    bool run() {
+        unsigned long now = ::millis();
+        // Unsigned subtraction keeps this correct across the millis() rollover
+        if (now - this->_lastActivityMillis < this->_interval) {
+            return false;
+        }
+        this->_lastActivityMillis = now;
+        if (this->_action()) {
+            this->_interval = this->_interval > this->_maxInterval / 2 ? this->_maxInterval : this->_interval * 2;
+        } else {
+            this->reset();
+        }
+        #ifdef MY_DEBUG
+        Serial.print("Next heartbeat in ");
+        Serial.println(this->_interval);
+        #endif
+        return true;
+    }
+
+    ~Heartbeat() {}
+};
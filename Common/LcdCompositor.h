@@ -0,0 +1,182 @@
+#pragma once
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stdint.h>
+#include <string.h>
+#endif
+
+// Character LCD compositor that only sends the characters that changed.
+//
+// The screen is split into regions, each a run of cells on one row with its own text. Text longer
+// than its region either gets cut off or, with a scroll interval, scrolls through it as a marquee.
+// Regions are composed into a frame buffer, which is compared with a shadow copy of what the LCD
+// shows. flush() then writes the changed cells, at most ChunkSize characters per call, moving the
+// cursor only where a run of changed cells starts. On an I2C backpack every character takes several
+// transfers of the 4-bit protocol, so calling update() from loop() spreads a screen update over
+// many passes instead of stalling message reception for the whole screen.
+//
+// Display is anything with setCursor(column, row) and write(uint8_t), e.g. LiquidCrystal_I2C. The
+// current time is passed in by the caller, as in Countdown.
+template <class Display, uint8_t Columns, uint8_t Rows, uint8_t Regions = Rows, uint8_t ChunkSize = 4>
+class LcdCompositor {
+  public:
+    // V_TEXT payloads are at most 25 characters
+    static constexpr uint8_t MaxTextLength = 25;
+
+  private:
+    // Blank cells between the end and the start of a scrolling text
+    static constexpr uint8_t ScrollGap = 3;
+    static constexpr uint8_t NoCursor = 0xFF;
+
+    struct Region {
+        uint8_t row;
+        uint8_t column;
+        uint8_t width = 0;
+        uint16_t scrollInterval;
+        char text[MaxTextLength + 1] = {};
+        uint8_t length = 0;
+        uint8_t offset = 0;
+        unsigned long scrolledMillis = 0;
+        bool changed = false;
+    };
+
+    Display &_display;
+    Region _regions[Regions];
+    char _frame[Rows][Columns];
+    char _shown[Rows][Columns];
+    bool _dirty = false;
+    uint8_t _flushRow = 0;
+    uint8_t _cursorRow = NoCursor;
+    uint8_t _cursorColumn = NoCursor;
+
+    bool _scrolls(const Region &region) const {
+        return region.scrollInterval > 0 && region.length > region.width;
+    }
+
+    void _compose(Region &region) {
+        char *cells = this->_frame[region.row] + region.column;
+        uint8_t period = region.length + ScrollGap;
+        for (uint8_t i = 0; i < region.width; i++) {
+            uint8_t position = this->_scrolls(region) ? (region.offset + i) % period : i;
+            cells[i] = position < region.length ? region.text[position] : ' ';
+        }
+        region.changed = false;
+        this->_dirty = true;
+    }
+
+    void _write(uint8_t row, uint8_t column) {
+        if (row != this->_cursorRow || column != this->_cursorColumn) {
+            this->_display.setCursor(column, row);
+            this->_cursorRow = row;
+        }
+        char c = this->_frame[row][column];
+        this->_display.write((uint8_t)c);
+        this->_shown[row][column] = c;
+        // Past the end of a row the controller continues on a row that is not the next one
+        this->_cursorColumn = column + 1 < Columns ? column + 1 : NoCursor;
+    }
+
+  public:
+    LcdCompositor(Display &display) : _display(display) {
+        ::memset(this->_frame, ' ', sizeof(this->_frame));
+        // Unknown contents, so the first flush writes every cell
+        ::memset(this->_shown, 0, sizeof(this->_shown));
+        this->_dirty = true;
+    }
+
+    // Places a region on the screen; a scrollInterval in milliseconds makes longer text scroll
+    void setRegion(uint8_t index, uint8_t row, uint8_t column, uint8_t width, uint16_t scrollInterval = 0) {
+        if (index >= Regions || row >= Rows || column >= Columns) {
+            return;
+        }
+        Region &region = this->_regions[index];
+        region.row = row;
+        region.column = column;
+        region.width = column + width > Columns ? Columns - column : width;
+        region.scrollInterval = scrollInterval;
+        region.offset = 0;
+        region.changed = true;
+    }
+
+    // Copies text into a region; does nothing if the text is unchanged
+    void setText(uint8_t index, const char *text) {
+        if (index >= Regions) {
+            return;
+        }
+        Region &region = this->_regions[index];
+        uint8_t length = ::strnlen(text, MaxTextLength);
+        if (length == region.length && ::strncmp(region.text, text, length) == 0) {
+            return;
+        }
+        ::memcpy(region.text, text, length);
+        region.text[length] = '\0';
+        region.length = length;
+        region.offset = 0;
+        region.changed = true;
+    }
+
+    const char *text(uint8_t index) const {
+        return index < Regions ? this->_regions[index].text : "";
+    }
+
+    // Makes the next flushes rewrite the whole screen, e.g. after the LCD was reset
+    void invalidate() {
+        ::memset(this->_shown, 0, sizeof(this->_shown));
+        this->_cursorRow = NoCursor;
+        this->_dirty = true;
+    }
+
+    // Advances the marquees and composes changed regions into the frame; returns true if the frame changed
+    bool compose(unsigned long now) {
+        bool composed = false;
+        for (uint8_t i = 0; i < Regions; i++) {
+            Region &region = this->_regions[i];
+            if (region.width == 0) {
+                continue;
+            }
+            if (this->_scrolls(region) && now - region.scrolledMillis >= region.scrollInterval) {
+                region.scrolledMillis = now;
+                region.offset = (region.offset + 1) % (region.length + ScrollGap);
+                region.changed = true;
+            }
+            if (region.changed) {
+                this->_compose(region);
+                composed = true;
+            }
+        }
+        return composed;
+    }
+
+    // Writes up to ChunkSize changed cells; returns true while cells are left to write
+    bool flush() {
+        if (!this->_dirty) {
+            return false;
+        }
+        uint8_t written = 0;
+        for (uint8_t rows = 0; rows < Rows; rows++) {
+            uint8_t row = this->_flushRow;
+            for (uint8_t column = 0; column < Columns; column++) {
+                if (this->_frame[row][column] == this->_shown[row][column]) {
+                    continue;
+                }
+                if (written == ChunkSize) {
+                    return true;
+                }
+                this->_write(row, column);
+                written++;
+            }
+            this->_flushRow = (row + 1) % Rows;
+        }
+        this->_dirty = false;
+        return false;
+    }
+
+    // Call from loop()
+    void update(unsigned long now) {
+        this->compose(now);
+        this->flush();
+    }
+
+    ~LcdCompositor() {}
+};
@@ -0,0 +1,163 @@
+#pragma once
+#include <MySensorsCommon.h>
+
+// Non-blocking MQ-series gas sensor engine.
+//
+// The sensor and the load resistor form a voltage divider on an analog pin. Calibration
+// averages the sensor resistance in clean air into Ro; a read averages the current resistance
+// Rs. Both are a series of samples taken from update() as they fall due, so loop() (and the
+// radio) keep running instead of blocking for seconds in delay(). The curve set and the sample
+// plans are template parameters. The logarithm of Rs/Ro is cached when a read completes, so the
+// concentration of each gas costs a single pow(), without sampling again.
+//
+// Based on http://sandboxelectronics.com/?p=165 (CC BY-NC-SA 3.0)
+
+// Line in the log-log chart of the datasheet through the point (x, y) = (log10(ppm), log10(Rs/Ro))
+struct MqCurve {
+    float x;
+    float y;
+    float slope;
+};
+
+#define GAS_LPG (0)
+#define GAS_CO (1)
+#define GAS_SMOKE (2)
+
+// A curve set provides the curves of one sensor model in flash, indexed by gas.
+// MQ-2 curves indexed by GAS_*, each formed by two points of the chart:
+// LPG (lg200, 0.21) to (lg10000, -0.59), CO (lg200, 0.72) to (lg10000, 0.15),
+// smoke (lg200, 0.53) to (lg10000, -0.22)
+struct Mq2Curves {
+    static const MqCurve *table() {
+        static const MqCurve curves[3] PROGMEM = {
+            {2.3, 0.21, -0.47},
+            {2.3, 0.72, -0.34},
+            {2.3, 0.53, -0.44}
+        };
+        return curves;
+    }
+};
+
+template <uint8_t Count, unsigned long IntervalMillis>
+struct MqSamplePlan {
+    static constexpr uint8_t SampleCount = Count;
+    static constexpr unsigned long SampleIntervalMillis = IntervalMillis;
+};
+
+// 50 samples 500 ms apart for calibration, 5 samples 50 ms apart per read
+typedef MqSamplePlan<50, 500> MqCalibrationPlan;
+typedef MqSamplePlan<5, 50> MqReadPlan;
+
+template <class Curves = Mq2Curves, class CalibrationPlan = MqCalibrationPlan, class ReadPlan = MqReadPlan>
+class MqSensor {
+  private:
+    enum class State : uint8_t {
+        Idle,
+        Calibrating,
+        Reading
+    };
+
+    uint8_t _pin;
+    float _loadResistance;
+    float _cleanAirFactor;
+    State _state = State::Idle;
+    bool _calibrated = false;
+    uint8_t _sampleCount = 0;
+    unsigned long _lastSampleMillis = 0;
+    float _sum = 0;
+    float _ro = 0;
+    float _rs = 0;
+    float _logRatio = 0;
+
+    // Sensor resistance derived from the voltage across the load resistor
+    float _resistance(int rawAdc) {
+        return this->_loadResistance * (1023 - rawAdc) / rawAdc;
+    }
+
+    void _start(State state) {
+        this->_state = state;
+        this->_sampleCount = 0;
+        this->_sum = 0;
+    }
+
+  public:
+    // loadResistance in kilo ohms; cleanAirFactor is Rs/Ro in clean air from the datasheet chart
+    MqSensor(uint8_t pin, float loadResistance = 5, float cleanAirFactor = 9.83)
+        : _pin(pin), _loadResistance(loadResistance), _cleanAirFactor(cleanAirFactor) {}
+
+    // Starts calibrating Ro. Please make sure the sensor is in clean air
+    void calibrate() {
+        this->_start(State::Calibrating);
+    }
+
+    // Starts a read; returns false if the sensor is busy or not calibrated yet
+    bool startRead() {
+        if (this->_state != State::Idle || !this->_calibrated) {
+            return false;
+        }
+        this->_start(State::Reading);
+        return true;
+    }
+
+    bool idle() const {
+        return this->_state == State::Idle;
+    }
+
+    bool calibrated() const {
+        return this->_calibrated;
+    }
+
+    // Call from loop(); takes a sample when one is due and returns true when a read completed
+    bool update() {
+        if (this->_state == State::Idle) {
+            return false;
+        }
+        bool calibrating = this->_state == State::Calibrating;
+        unsigned long interval = calibrating ? CalibrationPlan::SampleIntervalMillis : ReadPlan::SampleIntervalMillis;
+        unsigned long now = ::millis();
+        if (this->_sampleCount > 0 && now - this->_lastSampleMillis < interval) {
+            return false;
+        }
+        this->_lastSampleMillis = now;
+        this->_sum += this->_resistance(::analogRead(this->_pin));
+        this->_sampleCount++;
+
+        if (calibrating) {
+            if (this->_sampleCount < CalibrationPlan::SampleCount) {
+                return false;
+            }
+            this->_ro = this->_sum / CalibrationPlan::SampleCount / this->_cleanAirFactor;
+            this->_calibrated = true;
+            this->_state = State::Idle;
+            return false;
+        }
+        if (this->_sampleCount < ReadPlan::SampleCount) {
+            return false;
+        }
+        this->_rs = this->_sum / ReadPlan::SampleCount;
+        // Natural logarithm as in the original sketches, so the reported values do not change
+        this->_logRatio = ::log(this->_rs / this->_ro);
+        this->_state = State::Idle;
+        return true;
+    }
+
+    float ro() const {
+        return this->_ro;
+    }
+
+    // Sensor resistance of the last completed read, in kilo ohms
+    float rs() const {
+        return this->_rs;
+    }
+
+    // Concentration of a gas of the curve set from the last completed read, in ppm
+    int ppm(uint8_t gas) const {
+        const MqCurve *curve = Curves::table() + gas;
+        float x = pgm_read_float(&curve->x);
+        float y = pgm_read_float(&curve->y);
+        float slope = pgm_read_float(&curve->slope);
+        return ::pow(10, (this->_logRatio - y) / slope + x);
+    }
+
+    ~MqSensor() {}
+};
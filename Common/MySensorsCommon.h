@@ -9,6 +9,10 @@ public:
     virtual void setup() { }
     virtual void present() = 0;
     virtual bool report() = 0;
+    // Whether incoming messages for this child ID should be routed to receive()
+    virtual bool handles(uint8_t) { return false; }
+    // Handles an incoming message for one of the child IDs this sensor handles; returns true if consumed
+    virtual bool receive(const MyMessage &) { return false; }
     static constexpr uint8_t InvalidSensorId = 255;
 };
 
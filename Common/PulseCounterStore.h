@@ -0,0 +1,124 @@
+#pragma once
+#include <MySensorsCommon.h>
+
+// Keeps a pulse count across reboots without asking the controller for it.
+//
+// Checkpoints are written round robin into a ring of slots in the MySensors user EEPROM area
+// (saveState/loadState), so each slot only takes 1/slotCount of the writes. A slot holds the count
+// (4 bytes, little endian), a sequence number that goes up with every checkpoint and a CRC-16 of
+// both. The valid slot with the newest sequence number is the latest checkpoint; a slot torn by a
+// reset during the write fails its CRC and the previous checkpoint is used instead. slotCount must
+// stay below 128 so that the newest sequence number can be told apart after it wraps.
+class PulseCounterStore {
+  private:
+    static constexpr uint8_t SlotSize = 7;
+    uint8_t _firstPosition;
+    uint8_t _slotCount;
+    unsigned long _checkpointInterval;
+    uint8_t _checkpointCalls;
+    uint8_t _nextSlot = 0;
+    uint8_t _sequence = 0;
+    uint8_t _calls = 0;
+    unsigned long _savedCount = 0;
+    unsigned long _savedMillis = 0;
+
+    // CRC-16/CCITT-FALSE
+    static uint16_t _crc16(unsigned long count, uint8_t sequence) {
+        uint16_t crc = 0xFFFF;
+        for (uint8_t i = 0; i < 5; i++) {
+            crc ^= (uint16_t)(i < 4 ? (uint8_t)(count >> (8 * i)) : sequence) << 8;
+            for (uint8_t bit = 0; bit < 8; bit++) {
+                crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+            }
+        }
+        return crc;
+    }
+
+    uint8_t _slotPosition(uint8_t slot) {
+        return this->_firstPosition + slot * SlotSize;
+    }
+
+    bool _readSlot(uint8_t slot, unsigned long &count, uint8_t &sequence) {
+        uint8_t position = this->_slotPosition(slot);
+        count = 0;
+        for (uint8_t i = 0; i < 4; i++) {
+            count |= (unsigned long)::loadState(position + i) << (8 * i);
+        }
+        sequence = ::loadState(position + 4);
+        uint16_t crc = ::loadState(position + 5) | (uint16_t)::loadState(position + 6) << 8;
+        return crc == PulseCounterStore::_crc16(count, sequence);
+    }
+
+    void _writeSlot(uint8_t slot, unsigned long count, uint8_t sequence) {
+        uint8_t position = this->_slotPosition(slot);
+        uint16_t crc = PulseCounterStore::_crc16(count, sequence);
+        for (uint8_t i = 0; i < 4; i++) {
+            ::saveState(position + i, (uint8_t)(count >> (8 * i)));
+        }
+        ::saveState(position + 4, sequence);
+        // The CRC goes last so that the slot only becomes valid once it's complete
+        ::saveState(position + 5, (uint8_t)crc);
+        ::saveState(position + 6, (uint8_t)(crc >> 8));
+    }
+
+  public:
+    // Occupies slotCount * 7 bytes from firstPosition. Checkpoints are taken when the count changed
+    // and either checkpointInterval ms or checkpointCalls calls of checkpoint() have passed; the
+    // latter keeps checkpoints going in sleep mode, where millis() stands still.
+    PulseCounterStore(uint8_t firstPosition, uint8_t slotCount, unsigned long checkpointInterval, uint8_t checkpointCalls)
+        : _firstPosition(firstPosition), _slotCount(slotCount), _checkpointInterval(checkpointInterval),
+          _checkpointCalls(checkpointCalls) {}
+
+    // Returns the last checkpointed count, or 0 if there is none
+    unsigned long load() {
+        bool found = false;
+        for (uint8_t slot = 0; slot < this->_slotCount; slot++) {
+            unsigned long count;
+            uint8_t sequence;
+            if (this->_readSlot(slot, count, sequence) && (!found || (int8_t)(sequence - this->_sequence) > 0)) {
+                found = true;
+                this->_savedCount = count;
+                this->_sequence = sequence;
+                this->_nextSlot = (slot + 1) % this->_slotCount;
+            }
+        }
+        if (!found) {
+            this->_savedCount = 0;
+            this->_sequence = 0;
+            this->_nextSlot = 0;
+        }
+        this->_savedMillis = ::millis();
+        this->_calls = 0;
+        return this->_savedCount;
+    }
+
+    void save(unsigned long count) {
+        this->_sequence++;
+        this->_writeSlot(this->_nextSlot, count, this->_sequence);
+        this->_nextSlot = (this->_nextSlot + 1) % this->_slotCount;
+        this->_savedCount = count;
+        this->_savedMillis = ::millis();
+        this->_calls = 0;
+    }
+
+    // Saves the count if it changed and the checkpoint interval or call count has passed; returns true if saved
+    bool checkpoint(unsigned long count) {
+        if (this->_calls < this->_checkpointCalls) {
+            this->_calls++;
+        }
+        if (count == this->_savedCount ||
+            (::millis() - this->_savedMillis < this->_checkpointInterval && this->_calls < this->_checkpointCalls)) {
+            return false;
+        }
+        this->save(count);
+        return true;
+    }
+
+    // Replaces the stored count, e.g. with a value set by the controller, even if it's lower
+    void reset(unsigned long count) {
+        // The newest checkpoint wins, so older and higher counts don't come back
+        this->save(count);
+    }
+
+    ~PulseCounterStore() {}
+};
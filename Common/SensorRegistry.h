@@ -0,0 +1,41 @@
+#pragma once
+#include <MySensorsCommon.h>
+
+// Routes incoming messages to the ISensor handling their child ID.
+// The child ID -> sensor table is built once in setup(), so receive() is a single lookup no matter
+// how many sensors the node has. MaxChildId is the highest child ID used by the node.
+template <uint8_t MaxChildId>
+class SensorRegistry {
+  private:
+    ISensor *const *_sensors;
+    uint8_t _count;
+    ISensor *_handlers[MaxChildId + 1] = {};
+
+  public:
+    template <size_t Count>
+    SensorRegistry(ISensor *(&sensors)[Count]) : _sensors(sensors), _count(Count) {}
+
+    // Sets up all sensors and builds the routing table
+    void setup() {
+        for (uint8_t i = 0; i < this->_count; i++) {
+            ISensor *sensor = this->_sensors[i];
+            sensor->setup();
+            for (uint8_t childId = 0; childId <= MaxChildId; childId++) {
+                if (this->_handlers[childId] == nullptr && sensor->handles(childId)) {
+                    this->_handlers[childId] = sensor;
+                }
+            }
+        }
+    }
+
+    // Returns true if a sensor consumed the message
+    bool receive(const MyMessage &message) {
+        if (message.sensor > MaxChildId) {
+            return false;
+        }
+        ISensor *sensor = this->_handlers[message.sensor];
+        return sensor != nullptr && sensor->receive(message);
+    }
+
+    ~SensorRegistry() {}
+};
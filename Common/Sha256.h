@@ -0,0 +1,234 @@
+#pragma once
+#ifdef ARDUINO
+#include <Arduino.h>
+#else
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#define PROGMEM
+#define pgm_read_dword(address) (*(const uint32_t *)(address))
+#endif
+
+// Software SHA-256 and HMAC-SHA256 (FIPS 180-4, RFC 2104) for nodes without an ATSHA204.
+//
+// Streaming API: reset(), update() any number of times, then finish(). Nothing here depends on
+// MySensors, so the same code also builds on the host. The compression function is unrolled eight
+// rounds at a time, so the working variables rotate by renaming instead of being moved, and the
+// message schedule is expanded in place in a 16-word window (64 bytes of stack instead of 256).
+// Fully unrolling all 64 rounds would not fit the flash of an ATmega328.
+
+static const uint32_t Sha256RoundConstants[64] PROGMEM = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+class Sha256 {
+  public:
+    static constexpr uint8_t HashSize = 32;
+    static constexpr uint8_t BlockSize = 64;
+
+  private:
+    uint32_t _state[8];
+    uint8_t _block[BlockSize];
+    uint8_t _blockLength;
+    uint32_t _totalLength;
+
+    static constexpr uint32_t _rotr(uint32_t x, uint8_t n) {
+        return (x >> n) | (x << (32 - n));
+    }
+
+    static uint32_t _readBigEndian(const uint8_t *bytes) {
+        return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16) | ((uint32_t)bytes[2] << 8) | bytes[3];
+    }
+
+    static void _writeBigEndian(uint8_t *bytes, uint32_t value) {
+        bytes[0] = value >> 24;
+        bytes[1] = value >> 16;
+        bytes[2] = value >> 8;
+        bytes[3] = value;
+    }
+
+    // Returns message word i, expanding the schedule in place from round 16 on
+    static uint32_t _schedule(uint32_t *w, uint8_t i) {
+        if (i >= 16) {
+            uint32_t w2 = w[(i - 2) & 15];
+            uint32_t w15 = w[(i - 15) & 15];
+            w[i & 15] += (_rotr(w2, 17) ^ _rotr(w2, 19) ^ (w2 >> 10)) + w[(i - 7) & 15] +
+                         (_rotr(w15, 7) ^ _rotr(w15, 18) ^ (w15 >> 3));
+        }
+        return w[i & 15];
+    }
+
+    // One round; the caller rotates the roles of the working variables instead of moving them
+    static void _round(uint32_t a, uint32_t b, uint32_t c, uint32_t &d, uint32_t e, uint32_t f, uint32_t g, uint32_t &h, uint32_t *w, uint8_t i) {
+        uint32_t t1 = h + (_rotr(e, 6) ^ _rotr(e, 11) ^ _rotr(e, 25)) + (g ^ (e & (f ^ g))) +
+                      pgm_read_dword(&Sha256RoundConstants[i]) + _schedule(w, i);
+        d += t1;
+        h = t1 + (_rotr(a, 2) ^ _rotr(a, 13) ^ _rotr(a, 22)) + ((a & b) | (c & (a | b)));
+    }
+
+    void _compress(const uint8_t *block) {
+        uint32_t w[16];
+        for (uint8_t i = 0; i < 16; i++) {
+            w[i] = _readBigEndian(block + 4 * i);
+        }
+
+        uint32_t a = this->_state[0], b = this->_state[1], c = this->_state[2], d = this->_state[3];
+        uint32_t e = this->_state[4], f = this->_state[5], g = this->_state[6], h = this->_state[7];
+        for (uint8_t i = 0; i < 64; i += 8) {
+            _round(a, b, c, d, e, f, g, h, w, i + 0);
+            _round(h, a, b, c, d, e, f, g, w, i + 1);
+            _round(g, h, a, b, c, d, e, f, w, i + 2);
+            _round(f, g, h, a, b, c, d, e, w, i + 3);
+            _round(e, f, g, h, a, b, c, d, w, i + 4);
+            _round(d, e, f, g, h, a, b, c, w, i + 5);
+            _round(c, d, e, f, g, h, a, b, w, i + 6);
+            _round(b, c, d, e, f, g, h, a, w, i + 7);
+        }
+        this->_state[0] += a;
+        this->_state[1] += b;
+        this->_state[2] += c;
+        this->_state[3] += d;
+        this->_state[4] += e;
+        this->_state[5] += f;
+        this->_state[6] += g;
+        this->_state[7] += h;
+    }
+
+  public:
+    Sha256() {
+        this->reset();
+    }
+
+    void reset() {
+        this->_state[0] = 0x6a09e667;
+        this->_state[1] = 0xbb67ae85;
+        this->_state[2] = 0x3c6ef372;
+        this->_state[3] = 0xa54ff53a;
+        this->_state[4] = 0x510e527f;
+        this->_state[5] = 0x9b05688c;
+        this->_state[6] = 0x1f83d9ab;
+        this->_state[7] = 0x5be0cd19;
+        this->_blockLength = 0;
+        this->_totalLength = 0;
+    }
+
+    void update(const uint8_t *data, size_t length) {
+        this->_totalLength += length;
+        // Top up a partial block first; whole blocks are then compressed straight from data
+        if (this->_blockLength > 0) {
+            size_t space = BlockSize - this->_blockLength;
+            size_t count = space < length ? space : length;
+            memcpy(this->_block + this->_blockLength, data, count);
+            this->_blockLength += count;
+            data += count;
+            length -= count;
+            if (this->_blockLength < BlockSize) {
+                return;
+            }
+            this->_compress(this->_block);
+            this->_blockLength = 0;
+        }
+        for (; length >= BlockSize; data += BlockSize, length -= BlockSize) {
+            this->_compress(data);
+        }
+        memcpy(this->_block, data, length);
+        this->_blockLength = length;
+    }
+
+    // Writes the HashSize byte digest; call reset() before hashing the next message
+    void finish(uint8_t *hash) {
+        uint32_t bitLength = this->_totalLength << 3;
+        uint8_t padding = (this->_blockLength < BlockSize - 8 ? BlockSize : 2 * BlockSize) - 8 - this->_blockLength;
+        uint8_t trailer[BlockSize + 8] = {0x80};
+        // The byte count is 32 bits wide, so only the lowest byte of the upper length word can be set
+        trailer[padding + 3] = this->_totalLength >> 29;
+        _writeBigEndian(trailer + padding + 4, bitLength);
+        this->update(trailer, padding + 8);
+        for (uint8_t i = 0; i < 8; i++) {
+            _writeBigEndian(hash + 4 * i, this->_state[i]);
+        }
+    }
+
+    static void hash(const uint8_t *data, size_t length, uint8_t *hash) {
+        Sha256 sha;
+        sha.update(data, length);
+        sha.finish(hash);
+    }
+
+    // The inner and outer HMAC states are kept after the key block, so HMAC only hashes the key once
+    void exportState(uint32_t *state) const {
+        memcpy(state, this->_state, sizeof(this->_state));
+    }
+
+    void importState(const uint32_t *state, uint32_t totalLength) {
+        memcpy(this->_state, state, sizeof(this->_state));
+        this->_blockLength = 0;
+        this->_totalLength = totalLength;
+    }
+
+    ~Sha256() {}
+};
+
+class HmacSha256 {
+  private:
+    Sha256 _sha;
+    uint32_t _innerState[8];
+    uint32_t _outerState[8];
+
+  public:
+    // Keys longer than a block are hashed first, as RFC 2104 requires
+    HmacSha256(const uint8_t *key, size_t keyLength) {
+        uint8_t pad[Sha256::BlockSize] = {0};
+        if (keyLength > Sha256::BlockSize) {
+            Sha256::hash(key, keyLength, pad);
+        } else {
+            memcpy(pad, key, keyLength);
+        }
+
+        for (uint8_t i = 0; i < Sha256::BlockSize; i++) {
+            pad[i] ^= 0x36;
+        }
+        this->_sha.update(pad, Sha256::BlockSize);
+        this->_sha.exportState(this->_innerState);
+
+        this->_sha.reset();
+        for (uint8_t i = 0; i < Sha256::BlockSize; i++) {
+            pad[i] ^= 0x36 ^ 0x5c;
+        }
+        this->_sha.update(pad, Sha256::BlockSize);
+        this->_sha.exportState(this->_outerState);
+        memset(pad, 0, sizeof(pad));
+
+        this->reset();
+    }
+
+    // Starts a new message with the same key
+    void reset() {
+        this->_sha.importState(this->_innerState, Sha256::BlockSize);
+    }
+
+    void update(const uint8_t *data, size_t length) {
+        this->_sha.update(data, length);
+    }
+
+    // Writes the Sha256::HashSize byte MAC; call reset() before the next message
+    void finish(uint8_t *mac) {
+        uint8_t innerHash[Sha256::HashSize];
+        this->_sha.finish(innerHash);
+        this->_sha.importState(this->_outerState, Sha256::BlockSize);
+        this->_sha.update(innerHash, Sha256::HashSize);
+        this->_sha.finish(mac);
+    }
+
+    ~HmacSha256() {
+        memset(this->_innerState, 0, sizeof(this->_innerState));
+        memset(this->_outerState, 0, sizeof(this->_outerState));
+    }
+};
@@ -0,0 +1,105 @@
+// Host test of a 99 h countdown, as TimedRelay runs it, against simulated time.
+//
+//   g++ -std=gnu++11 -O2 -o CountdownTest CountdownTest.cpp && ./CountdownTest
+//
+// loop() is called with random latency: mostly a few ms, now and then a stall of up to 2 s as
+// when the relay beeps or the serial port blocks. The clock is 32 bits wide like millis() on AVR,
+// not the 64 bit unsigned long of the host, and starts an hour before it overflows, so the
+// countdown really crosses 0xFFFFFFFF. Countdown from ../Countdown.h has to expire on the first
+// call at or after its deadline and step its minutes down one by one, each on the first call past
+// the minute boundary. For comparison, the old sketch's way of counting, decrementing a minute
+// counter whenever a minute has passed since the last decrement, is run on the same calls.
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+#include "../Countdown.h"
+
+static constexpr uint32_t CountdownSeconds = 99UL * 3600;
+static constexpr uint32_t StartMillis = UINT32_MAX - 3600000UL;
+
+static uint32_t _loopLatency() {
+    return ::rand() % 100 == 0 ? ::rand() % 2000 : 1 + ::rand() % 20;
+}
+
+int main() {
+    ::srand(1);
+    Countdown countdown;
+    countdown.start(StartMillis, CountdownSeconds);
+    uint32_t deadline = StartMillis + CountdownSeconds * (uint32_t)1000;
+
+    uint32_t now = StartMillis;
+    uint32_t previousNow = now;
+    uint32_t minutes = countdown.remainingMinutes(now);
+    int failures = 0;
+    if (deadline >= StartMillis) {
+        ::printf("FAIL: the clock does not overflow before the deadline\n");
+        failures++;
+    }
+    if (minutes != CountdownSeconds / 60) {
+        ::printf("FAIL: starts at %lu minutes\n", (unsigned long)minutes);
+        failures++;
+    }
+
+    // The old way: a minute counter decremented a minute after the previous decrement was noticed
+    unsigned long naiveMinutes = CountdownSeconds / 60;
+    uint32_t naiveLastMillis = StartMillis;
+    uint32_t naiveEnd = 0;
+    bool naiveDone = false;
+
+    unsigned long calls = 0;
+    for (;;) {
+        previousNow = now;
+        now += _loopLatency();
+        calls++;
+        if (!naiveDone && now - naiveLastMillis >= (uint32_t)60000) {
+            naiveLastMillis = now;
+            if (--naiveMinutes == 0) {
+                naiveDone = true;
+                naiveEnd = now;
+            }
+        }
+        if (countdown.expired(now)) {
+            break;
+        }
+        uint32_t left = countdown.remainingMinutes(now);
+        if (left != minutes) {
+            // The minute has to change on the first call past its boundary, and by one
+            uint32_t boundary = deadline - left * (uint32_t)60000;
+            if (left != minutes - 1 || (int32_t)(now - boundary) < 0 || (int32_t)(previousNow - boundary) >= 0) {
+                ::printf("FAIL: %lu -> %lu minutes at %lu ms before the deadline\n",
+                         (unsigned long)minutes, (unsigned long)left, (unsigned long)(deadline - now));
+                failures++;
+            }
+            minutes = left;
+        }
+    }
+    int32_t late = (int32_t)(now - deadline);
+    // Runs the old counter to its end on the same kind of calls
+    while (!naiveDone) {
+        now += _loopLatency();
+        if (now - naiveLastMillis >= (uint32_t)60000) {
+            naiveLastMillis = now;
+            if (--naiveMinutes == 0) {
+                naiveDone = true;
+                naiveEnd = now;
+            }
+        }
+    }
+
+    // Countdown stops on the call that passes the deadline, so it can be late by at most the gap
+    // to the previous call
+    if (late < 0 || (int32_t)(previousNow - deadline) >= 0) {
+        ::printf("FAIL: expired %ld ms after the deadline\n", (long)late);
+        failures++;
+    }
+    if (minutes != 1) {
+        ::printf("FAIL: showed %lu minutes before expiring\n", (unsigned long)minutes);
+        failures++;
+    }
+    ::printf("99 h countdown over %lu loop() calls\n", calls);
+    ::printf("  Countdown:        expired %ld ms after the deadline\n", (long)late);
+    ::printf("  minute decrement: ended %.1f s after the deadline\n", (int32_t)(naiveEnd - deadline) / 1000.0);
+    ::printf("%s\n", failures ? "FAILED" : "PASSED");
+    return failures ? 1 : 0;
+}
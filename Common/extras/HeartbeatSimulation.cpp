@@ -0,0 +1,97 @@
+// Host simulation of the heartbeat traffic of our heartbeat nodes, fixed interval vs Heartbeat.
+//
+//   g++ -std=gnu++11 -O2 -o HeartbeatSimulation HeartbeatSimulation.cpp && ./HeartbeatSimulation
+//
+// Every node sends its other messages at random with the given mean rate and each transmission
+// fails with LossRate. The old sketches sent their heartbeat (or their states) every minimum
+// interval no matter what; Heartbeat is the real scheduler from ../Heartbeat.h run on simulated
+// time. Channel utilization is the share of time the channel carries heartbeat packets.
+#include <cstdio>
+#include <cstdlib>
+#include <stdint.h>
+
+static unsigned long _now = 0;
+static unsigned long _sent = 0;
+
+unsigned long millis() {
+    return _now;
+}
+
+static bool _transmit() {
+    _sent++;
+    return ::rand() >= RAND_MAX * 0.01; // 1% loss
+}
+
+bool sendHeartbeat() {
+    return _transmit();
+}
+
+#include "../Heartbeat.h"
+
+static constexpr unsigned long StepMillis = 100;
+static constexpr unsigned long SimulatedMillis = 24UL * 3600 * 1000;
+// 32 byte payload plus preamble, address and CRC at 250 kbps, plus the auto ACK
+static constexpr double AirtimeMillis = 1.5;
+
+struct Node {
+    const char *name;
+    unsigned long minInterval;
+    unsigned long maxInterval;
+    uint8_t messagesPerHeartbeat; // Nodes that send their states as the heartbeat
+    double otherMessagesPerHour;
+};
+
+static const Node Fleet[] = {
+    {"Repeater_1", 3000, 60000, 1, 0},
+    {"Sprinkler", 30000, 240000, 1, 12},
+    {"Sprinkler_2", 30000, 240000, 1, 12},
+    {"GarageController", 30000, 240000, 2, 4},
+    {"FloorLamp", 10000, 80000, 1, 2},
+    {"RelayWithHeartbeat", 10000, 80000, 1, 2},
+    {"WaterHeater", 30000, 240000, 1, 6},
+};
+
+static uint8_t _messagesPerHeartbeat = 1;
+
+static bool _sendStates() {
+    bool ok = true;
+    for (uint8_t i = 0; i < _messagesPerHeartbeat; i++) {
+        ok = _transmit() && ok;
+    }
+    return ok;
+}
+
+int main() {
+    ::srand(1);
+    unsigned long totalFixed = 0;
+    unsigned long totalAdaptive = 0;
+    ::printf("%-20s %12s %12s\n", "node", "fixed", "adaptive");
+    for (const Node &node : Fleet) {
+        _messagesPerHeartbeat = node.messagesPerHeartbeat;
+        unsigned long fixed = SimulatedMillis / node.minInterval * node.messagesPerHeartbeat;
+        double otherPerStep = node.otherMessagesPerHour * StepMillis / 3600000.0;
+
+        _now = 0;
+        Heartbeat heartbeat(node.minInterval, node.maxInterval,
+                            node.messagesPerHeartbeat > 1 ? _sendStates : ::sendHeartbeat);
+        unsigned long adaptive = 0;
+        for (_now = 0; _now < SimulatedMillis; _now += StepMillis) {
+            if (::rand() < RAND_MAX * otherPerStep) {
+                _transmit();
+                heartbeat.notifySent();
+            }
+            unsigned long before = _sent;
+            heartbeat.run();
+            adaptive += _sent - before;
+        }
+        ::printf("%-20s %12lu %12lu\n", node.name, fixed, adaptive);
+        totalFixed += fixed;
+        totalAdaptive += adaptive;
+    }
+    double fixedUtilization = totalFixed * AirtimeMillis / SimulatedMillis * 100;
+    double adaptiveUtilization = totalAdaptive * AirtimeMillis / SimulatedMillis * 100;
+    ::printf("%-20s %12lu %12lu\n", "total per day", totalFixed, totalAdaptive);
+    ::printf("channel utilization  %11.4f%% %11.4f%% (%.0f%% less)\n", fixedUtilization, adaptiveUtilization,
+             100 - adaptiveUtilization / fixedUtilization * 100);
+    return totalAdaptive < totalFixed ? 0 : 1;
+}
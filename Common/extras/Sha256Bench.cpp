@@ -0,0 +1,146 @@
+// Host test and benchmark of ../Sha256.h.
+//
+//   g++ -std=gnu++11 -O2 -o Sha256Bench Sha256Bench.cpp && ./Sha256Bench
+//
+// Checks Sha256 against the FIPS 180-4 examples and HmacSha256 against RFC 4231, including
+// messages fed in pieces of every size from 1 to 130 bytes. Then times the throughput of Sha256
+// and the latency of one HMAC over a 64 byte message, about what signing a MySensors message with
+// its nonce takes, next to the execution times of the ATSHA204A commands from the constants in
+// Samples/SecurityPersonalizer/sha204_library.h. The host numbers are not AVR numbers; they are
+// for comparing changes to Sha256.h, and the ATSHA204A times do not include the single-wire
+// transfer.
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <stdint.h>
+
+#include "../Sha256.h"
+
+struct HashVector {
+    const char *message;
+    unsigned long repeat;
+    const char *digest;
+};
+
+static const HashVector HashVectors[] = {
+    {"", 1, "e3b0c44298fc1c149afbf4c8996fb92427ae41e4649b934ca495991b7852b855"},
+    {"abc", 1, "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad"},
+    {"abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1,
+     "248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1"},
+    {"a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0"},
+};
+
+struct MacVector {
+    uint8_t keyByte; // 0 means the key is keyText
+    size_t keyLength;
+    const char *keyText;
+    const char *message;
+    const char *mac;
+};
+
+// RFC 4231 test cases 1, 2 and 6
+static const MacVector MacVectors[] = {
+    {0x0b, 20, nullptr, "Hi There", "b0344c61d8db38535ca8afceaf0bf12b881dc200c9833da726e9376c2e32cff7"},
+    {0, 4, "Jefe", "what do ya want for nothing?", "5bdcc146bf60754e6a042426089575c75a003f089d2739839dec58b964ec3843"},
+    {0xaa, 131, nullptr, "Test Using Larger Than Block-Size Key - Hash Key First",
+     "60e431591ee0b67f0d8a26aacbf5b77f8e0bc6213728c5140546040f0ee37f54"},
+};
+
+static bool _matches(const uint8_t *digest, const char *hex) {
+    char text[2 * Sha256::HashSize + 1];
+    for (uint8_t i = 0; i < Sha256::HashSize; i++) {
+        ::snprintf(text + 2 * i, 3, "%02x", digest[i]);
+    }
+    return ::strcmp(text, hex) == 0;
+}
+
+static double _nanosSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+    int failures = 0;
+    uint8_t digest[Sha256::HashSize];
+
+    for (const HashVector &vector : HashVectors) {
+        size_t length = ::strlen(vector.message);
+        Sha256 sha;
+        for (unsigned long i = 0; i < vector.repeat; i++) {
+            sha.update((const uint8_t *)vector.message, length);
+        }
+        sha.finish(digest);
+        if (!_matches(digest, vector.digest)) {
+            ::printf("FAIL: SHA-256 of %lu x \"%s\"\n", vector.repeat, vector.message);
+            failures++;
+        }
+    }
+
+    // The same message split into pieces of every size, to cover the partial block paths
+    static uint8_t message[1000];
+    for (size_t i = 0; i < sizeof(message); i++) {
+        message[i] = (uint8_t)(i * 7 + 3);
+    }
+    uint8_t whole[Sha256::HashSize];
+    Sha256::hash(message, sizeof(message), whole);
+    for (size_t piece = 1; piece <= 130; piece++) {
+        Sha256 sha;
+        for (size_t offset = 0; offset < sizeof(message); offset += piece) {
+            sha.update(message + offset, piece < sizeof(message) - offset ? piece : sizeof(message) - offset);
+        }
+        sha.finish(digest);
+        if (::memcmp(digest, whole, sizeof(digest)) != 0) {
+            ::printf("FAIL: SHA-256 fed in %lu byte pieces\n", (unsigned long)piece);
+            failures++;
+        }
+    }
+
+    for (const MacVector &vector : MacVectors) {
+        uint8_t key[131];
+        if (vector.keyText) {
+            ::memcpy(key, vector.keyText, vector.keyLength);
+        } else {
+            ::memset(key, vector.keyByte, vector.keyLength);
+        }
+        HmacSha256 hmac(key, vector.keyLength);
+        // Twice, to check that reset() brings back the keyed state
+        for (int round = 0; round < 2; round++) {
+            hmac.reset();
+            hmac.update((const uint8_t *)vector.message, ::strlen(vector.message));
+            hmac.finish(digest);
+            if (!_matches(digest, vector.mac)) {
+                ::printf("FAIL: HMAC-SHA256 of \"%s\", round %d\n", vector.message, round + 1);
+                failures++;
+            }
+        }
+    }
+
+    // Throughput over 1 MiB; each digest is fed back so nothing can be optimized away
+    static uint8_t buffer[1 << 20];
+    auto start = std::chrono::steady_clock::now();
+    const int Passes = 16;
+    for (int pass = 0; pass < Passes; pass++) {
+        Sha256::hash(buffer, sizeof(buffer), digest);
+        ::memcpy(buffer, digest, sizeof(digest));
+    }
+    double nanosPerByte = _nanosSince(start) / (Passes * (double)sizeof(buffer));
+
+    // Latency of one HMAC with the key already set up, as a signing node would hold it
+    uint8_t key[32] = {1, 2, 3};
+    HmacSha256 hmac(key, sizeof(key));
+    uint8_t signedData[64] = {0};
+    const int Macs = 200000;
+    start = std::chrono::steady_clock::now();
+    for (int i = 0; i < Macs; i++) {
+        hmac.reset();
+        hmac.update(signedData, sizeof(signedData));
+        hmac.finish(signedData);
+    }
+    double macMicros = _nanosSince(start) / Macs / 1000;
+
+    ::printf("Sha256 on this host:             %.2f ns/byte (%.0f MB/s)\n", nanosPerByte, 1000 / nanosPerByte);
+    ::printf("HmacSha256 of 64 bytes:          %.2f us\n", macMicros);
+    ::printf("ATSHA204A HMAC command:          27 ms typical, 69 ms max\n");
+    ::printf("ATSHA204A MAC command:           12 ms typical, 35 ms max\n");
+    ::printf("%s\n", failures ? "FAILED" : "all SHA-256 checks passed");
+    return failures ? 1 : 0;
+}
@@ -34,124 +34,64 @@
 
 #include <SPI.h>
 #include <MySensors.h>
-
-#define RELAY_ON 0  // GPIO value to write to turn on attached relay
-#define RELAY_OFF 1 // GPIO value to write to turn off attached relay
+#include <ControlGroup.h>
+#include <Heartbeat.h>
 
 #define HEARTBEAT_INTERVAL 30000
-unsigned long nextHeartbeatMillis = 0;
-
-class ControlGroup {
-  private:
-    bool lastSensorState = false;
-
-    MyMessage msgSensorState;
-
-    bool IsDoorOpen() {
-      return digitalRead(this->SensorPin) == HIGH;
-    }
-  
-    void SetControl(bool state) {
-      digitalWrite(this->ControlPin, state ? RELAY_ON : RELAY_OFF);
-      // Store state in eeprom
-      saveState(this->ControlId, state);
-
-      // Write some debug info
-      Serial.print("Set door control with Sensor ID:");
-      Serial.print(this->ControlId);
-      Serial.print(", New status: ");
-      Serial.println(state);
-    }
-    
-  public:
-    int SensorId;
-    int ControlId;
-    int SensorPin;
-    int ControlPin;
-
-    ControlGroup(int sensorId, int controlId, int sensorPin, int controlPin): SensorId(sensorId), ControlId(controlId), SensorPin(sensorPin), ControlPin(controlPin), msgSensorState(sensorId, V_TRIPPED) {
-    }
-
-    void Init() {
-      pinMode(this->SensorPin, INPUT);
-      pinMode(this->ControlPin, OUTPUT);
-
-      SetControl(false);
-    }
-
-    void Present() {
-      present(this->ControlId, S_LIGHT);
-      present(this->SensorId, S_DOOR);
-    }
-
-    void Receive(const MyMessage &message) {
-      if (message.type == V_LIGHT && message.sensor == this->ControlId) {
-        // Operate the door relay
-        SetControl(message.getBool());
-        wait(200);
-        SetControl(false);
-      }
-    }
-
-    void CheckSensor() {
-      bool state = IsDoorOpen();
-      if (state != this->lastSensorState) {
-        this->lastSensorState = state;
-        SendState();
-      }
-    }
-
-    void SendState() {
-      send(msgSensorState.set(this->lastSensorState));
-      Serial.print("Sending state for sensor ID: ");
-      Serial.print(this->SensorId);
-      Serial.print(", Value: ");
-      Serial.print(this->lastSensorState);
-      Serial.println();
-    }
-};
-
-ControlGroup door1(1, 2, 2, 3);
-ControlGroup door2(3, 4, 4, 5);
+#define HEARTBEAT_MAX_INTERVAL 240000
+
+// The door sensor must read the same level for this long before a change is reported
+#define DEBOUNCE_MILLIS 50
+// How long the relay is closed to operate the door opener
+#define PULSE_MILLIS 200
+
+// Relay: child ID, pin; door sensor: child ID, pin
+typedef ControlGroup<Relay<2, 3, RelayMode::Pulse, LOW, NoPin, PULSE_MILLIS>, DoorSensor<1, 2, HIGH, DEBOUNCE_MILLIS>> Door1;
+typedef ControlGroup<Relay<4, 5, RelayMode::Pulse, LOW, NoPin, PULSE_MILLIS>, DoorSensor<3, 4, HIGH, DEBOUNCE_MILLIS>> Door2;
+Door1 door1;
+Door2 door2;
+typedef ControlGroups<ControlGroupRef<Door1, door1>, ControlGroupRef<Door2, door2>> Doors;
+
+bool sendStates();
+Heartbeat heartbeat(HEARTBEAT_INTERVAL, HEARTBEAT_MAX_INTERVAL, sendStates);
+
+// Both sensor pins (2 and 4) are on port D
+ISR(PCINT2_vect) {
+  Doors::onPinChange();
+}
 
 void before() { 
-  door1.Init();
-  door2.Init();
+  Doors::setup();
 }
 
 void setup() {
-  nextHeartbeatMillis = millis() + HEARTBEAT_INTERVAL;
 }
 
 void presentation()  
 {   
   // Send the sketch version information to the gateway and Controller
-  sendSketchInfo("Garage controller", "2.1");
-  door1.Present();
-  door2.Present();
+  sendSketchInfo("Garage controller", "3.0");
+  Doors::present();
 }
 
 
 void loop() 
 {
-  unsigned long now = millis();
-  if (now >= nextHeartbeatMillis) {
-    nextHeartbeatMillis = now + HEARTBEAT_INTERVAL;
-    #ifdef MY_DEBUG
-    Serial.print("Sending status as heartbeat.");
-    #endif
-
-    door1.SendState();
-    door2.SendState();
+  heartbeat.run();
+  if (Doors::update()) {
+    heartbeat.notifySent();
   }
-  door1.CheckSensor();
-  door2.CheckSensor();
 }
 
-void receive(const MyMessage &message) {
-  door1.Receive(message);
-  door2.Receive(message);
+// The door states double as the heartbeat
+bool sendStates() {
+  #ifdef MY_DEBUG
+  Serial.print("Sending status as heartbeat.");
+  #endif
+  bool success = door1.sensor().sendState();
+  return door2.sensor().sendState() && success;
 }
 
-
-
+void receive(const MyMessage &message) {
+  Doors::receive(message);
+}
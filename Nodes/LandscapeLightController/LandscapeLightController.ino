@@ -6,6 +6,7 @@
 #include <MySensorsCommon.h>
 #include <DhtSensor.h>
 #include <DimmerSensor.h>
+#include <SensorRegistry.h>
 
 #define         CHILD_ID_DIMMER               0
 #define         CHILD_ID_TEMPERATURE          1
@@ -21,13 +22,12 @@ MessageSender _messageSender;
 DhtSensor _dhtSensor(DHT_PIN, CHILD_ID_TEMPERATURE, CHILD_ID_HUMIDITY, _messageSender);
 DimmerSensor _dimmerSensor(DIMMER_PIN, CHILD_ID_DIMMER, _messageSender);
 ISensor* _sensors[2] = { &_dimmerSensor, &_dhtSensor };
+SensorRegistry<CHILD_ID_HUMIDITY> _sensorRegistry(_sensors);
 
 void setup()
 {
     Serial.println("Setting up sensors...");
-    for (ISensor* sensor : _sensors) {
-        sensor->setup();
-    }
+    _sensorRegistry.setup();
 }
 
 void presentation()
@@ -54,10 +54,5 @@ void loop() {
 }
 
 void receive(const MyMessage &message) {
-    if (message.type == V_PERCENTAGE && message.sensor == CHILD_ID_DIMMER) {
-        uint8_t value = message.getByte();
-        Serial.print("Incoming dimmer value: ");
-        Serial.print(value);
-        _dimmerSensor.set(value);
-    }
+    _sensorRegistry.receive(message);
 }
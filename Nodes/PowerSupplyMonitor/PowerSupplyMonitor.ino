@@ -22,6 +22,7 @@
  * Version 1.0: Henrik EKblad
  * Version 1.1 - 2016-07-20: Converted to MySensors v2.0 and added various improvements - Torben Woltjen (mozzbozz)
  * Version 2.0 - Enable signature, add node ID - gildorwang
+ * Version 2.1 - Temperature controlled fan with tach feedback
  * 
  * DESCRIPTION
  * This sketch provides an example of how to implement a humidity/temperature
@@ -40,11 +41,12 @@
 #include <SPI.h>
 #include <MySensors.h>  
 #include <DHT.h>
-#include <PWM.h>
+#include <FanController.h>
 
-//use pin 11 on the Mega instead, otherwise there is a frequency cap at 31 Hz
-int fan = 3;                // the pin that the LED is attached to
-int32_t frequency = 25000; //frequency (in Hz)
+// The fan PWM is on pin 3 and its tach output on pin 8, see FanController.h
+#define FAN_SET_POINT 40 // Temperature (in degrees Celsius) the fan holds the power supply at
+#define FAN_MIN_RPM 600
+#define FAN_MAX_RPM 3000
 
 // Set this to the pin you connected the DHT's data pin to
 #define DHT_DATA_PIN 5
@@ -58,6 +60,7 @@ static const uint64_t UPDATE_INTERVAL = 10000;
 
 #define CHILD_ID_HUM 0
 #define CHILD_ID_TEMP 1
+#define CHILD_ID_FAN 2
 #define LED_PIN 6
 
 float lastTemp;
@@ -69,15 +72,22 @@ unsigned long ledOffMillis;
 MyMessage msgHum(CHILD_ID_HUM, V_HUM);
 MyMessage msgTemp(CHILD_ID_TEMP, V_TEMP);
 DHT dht;
+MessageSender messageSender;
+FanController fan(CHILD_ID_FAN, messageSender, FAN_SET_POINT, FAN_MIN_RPM, FAN_MAX_RPM);
+
+ISR(TIMER1_CAPT_vect) {
+    fan.onCapture();
+}
 
 void presentation()  
 { 
     // Send the sketch version information to the gateway
-    sendSketchInfo("PowerSupplyMonitor", "2.0");
+    sendSketchInfo("PowerSupplyMonitor", "2.1");
     
     // Register all sensors to gw (they will be created as child devices)
     present(CHILD_ID_HUM, S_HUM);
     present(CHILD_ID_TEMP, S_TEMP);
+    fan.present();
     
     metric = getControllerConfig().isMetric;
 }
@@ -86,16 +96,7 @@ void presentation()
 void setup()
 {
     /********* Setup PWM for Fan control **********/
-    //initialize all timers except for 0, to save time keeping functions
-    InitTimersSafe(); 
-
-    //sets the frequency for the specified pin
-    bool success = SetPinFrequencySafe(fan, frequency);
-    
-    //if the pin frequency was set successfully, turn pin 13 on
-    if(!success) {
-        Serial.println("Error: Failed to set PWM");
-    }
+    fan.setup();
 
     /********* DHT Setup **********/
     pinMode(LED_PIN, OUTPUT);
@@ -111,8 +112,7 @@ void setup()
 
 void loop()      
 {  
-    //Write PWM
-    pwmWrite(fan, 220);
+    fan.report();
 
     unsigned long currentMillis = millis();
     if (currentMillis >= ledOffMillis) {
@@ -128,6 +128,7 @@ void loop()
         
         // Get temperature from DHT library
         float temperature = dht.getTemperature();
+        fan.setTemperature(temperature + SENSOR_TEMP_OFFSET);
         if (isnan(temperature)) {
             isWorking = false;
             Serial.println("Failed reading temperature from DHT!");
@@ -166,3 +167,7 @@ void loop()
         }
     }
 }
+
+void receive(const MyMessage &message) {
+    messageSender.handleAck(message);
+}
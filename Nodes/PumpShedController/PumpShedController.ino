@@ -8,6 +8,7 @@
 #include <MySensorsCommon.h>
 #include <DhtSensor.h>
 #include <DimmerSensor.h>
+#include <SensorRegistry.h>
 //#include <RadioMotionSensor.h>
 
 #define         CHILD_ID_DIMMER               0
@@ -23,18 +24,33 @@ const uint8_t MaxDimmerValue = 60;
 // const uint8_t InvalidDimmerValue = 100;
 // uint8_t _dimmerValue = 0;
 
+// Dimmer limited to MaxDimmerValue
+class PumpShedDimmerSensor : public DimmerSensor {
+    public:
+        PumpShedDimmerSensor(uint8_t pin, uint8_t sensorId, MessageSender messageSender)
+            : DimmerSensor(pin, sensorId, messageSender) {}
+
+        uint8_t coerce(uint8_t percentage) {
+            if (percentage > MaxDimmerValue) {
+                Serial.print("Coerced to ");
+                Serial.println(MaxDimmerValue);
+                return MaxDimmerValue;
+            }
+            return percentage;
+        }
+};
+
 MessageSender _messageSender;
 DhtSensor _dhtSensor(DHT_PIN, CHILD_ID_TEMPERATURE, CHILD_ID_HUMIDITY, _messageSender);
-DimmerSensor _dimmerSensor(DIMMER_PIN, CHILD_ID_DIMMER, _messageSender);
+PumpShedDimmerSensor _dimmerSensor(DIMMER_PIN, CHILD_ID_DIMMER, _messageSender);
 //RadioMotionSensor _radioMotionSensor(MOTION_PIN, CHILD_ID_MOTION, _messageSender);
 ISensor* _sensors[2] = { &_dimmerSensor, &_dhtSensor/* , &_radioMotionSensor */ };
+SensorRegistry<CHILD_ID_MOTION> _sensorRegistry(_sensors);
 
 void setup()
 {
     Serial.println("Setting up sensors...");
-    for (ISensor* sensor : _sensors) {
-        sensor->setup();
-    }
+    _sensorRegistry.setup();
 }
 
 void presentation()
@@ -64,16 +80,5 @@ void loop() {
 }
 
 void receive(const MyMessage &message) {
-    if (message.type == V_PERCENTAGE && message.sensor == CHILD_ID_DIMMER) {
-        uint8_t value = message.getByte();
-        Serial.print("Incoming dimmer value: ");
-        Serial.println(value);
-        if (value > MaxDimmerValue) {
-            value = MaxDimmerValue;
-            Serial.print("Coerced to ");
-            Serial.println(MaxDimmerValue);
-        }
-        _dimmerSensor.set(value);
-        // _dimmerValue = InvalidDimmerValue;
-    }
+    _sensorRegistry.receive(message);
 }
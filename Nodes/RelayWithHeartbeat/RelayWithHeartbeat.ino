@@ -39,64 +39,41 @@
 
 #include <SPI.h>
 #include <MySensors.h>
+#include <ControlGroup.h>
+#include <Heartbeat.h>
 
-#define RELAY_1  3  // Arduino Digital I/O pin number for first relay (second on pin+1 etc)
-#define NUMBER_OF_RELAYS 1 // Total number of attached relays
-#define RELAY_ON 0  // GPIO value to write to turn on attached relay
-#define RELAY_OFF 1 // GPIO value to write to turn off attached relay
+#define RELAY_1  3  // Arduino Digital I/O pin number for the relay
 
 #define HEARTBEAT_INTERVAL 10000
-unsigned long nextHeartbeatMillis = 0;
+#define HEARTBEAT_MAX_INTERVAL 80000
+Heartbeat heartbeat(HEARTBEAT_INTERVAL, HEARTBEAT_MAX_INTERVAL);
+
+typedef ControlGroup<Relay<1, RELAY_1>> Relay1;
+Relay1 relay1;
+typedef ControlGroups<ControlGroupRef<Relay1, relay1>> Relays;
 
 void before() { 
-  for (int sensor=1, pin=RELAY_1; sensor<=NUMBER_OF_RELAYS;sensor++, pin++) {
-    // Then set relay pins in output mode
-    pinMode(pin, OUTPUT);   
-    // Set relay to last known state (using eeprom storage) 
-    digitalWrite(pin, loadState(sensor)?RELAY_ON:RELAY_OFF);
-  }
+  Relays::setup();
 }
 
 void setup() {
-  nextHeartbeatMillis = millis() + HEARTBEAT_INTERVAL;
 }
 
 void presentation()  
 {   
   // Send the sketch version information to the gateway and Controller
-  sendSketchInfo("RelayWithHeartbeat", "1.1");
-
-  for (int sensor=1, pin=RELAY_1; sensor<=NUMBER_OF_RELAYS;sensor++, pin++) {
-    // Register all sensors to gw (they will be created as child devices)
-    present(sensor, S_LIGHT);
-  }
+  sendSketchInfo("RelayWithHeartbeat", "2.0");
+  Relays::present();
 }
 
 
 void loop() 
 {
-  unsigned long now = millis();
-  if (now >= nextHeartbeatMillis) {
-    nextHeartbeatMillis = now + HEARTBEAT_INTERVAL;
-    #ifdef MY_DEBUG
-    Serial.print("Sending heartbeat.");
-    #endif
-    sendHeartbeat();
-  }
+  heartbeat.run();
 }
 
 void receive(const MyMessage &message) {
-  // We only expect one type of message from controller. But we better check anyway.
-  if (message.type==V_LIGHT) {
-     // Change relay state
-     digitalWrite(message.sensor-1+RELAY_1, message.getBool()?RELAY_ON:RELAY_OFF);
-     // Store state in eeprom
-     saveState(message.sensor, message.getBool());
-     // Write some debug info
-     Serial.print("Incoming change for sensor:");
-     Serial.print(message.sensor);
-     Serial.print(", New status: ");
-     Serial.println(message.getBool());
-   } 
+  if (Relays::receive(message)) {
+    heartbeat.notifySent();
+  }
 }
-
@@ -30,15 +30,15 @@
 
 #define MY_NODE_ID 3
 #define HEARTBEAT_INTERVAL 3000
+#define HEARTBEAT_MAX_INTERVAL 60000
 
 // Enabled repeater feature for this node
 #define MY_REPEATER_FEATURE
 
-#include <MySensorsCustomConfig.h>
-#include <SPI.h>
-#include <MySensors.h>
+#include <MySensorsCommon.h>
+#include <Heartbeat.h>
 
-unsigned long nextHeartbeatMillis;
+Heartbeat _heartbeat(HEARTBEAT_INTERVAL, HEARTBEAT_MAX_INTERVAL);
 
 void setup() {
   
@@ -52,10 +52,6 @@ void presentation()
 
 void loop() 
 {
-  unsigned long now = millis();
-  if (now >= nextHeartbeatMillis) {
-    sendHeartbeat();
-    nextHeartbeatMillis = now + HEARTBEAT_INTERVAL;
-  }
+  _heartbeat.run();
 }
 
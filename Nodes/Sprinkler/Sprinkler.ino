@@ -27,6 +27,7 @@
 #include <MySensorsCustomConfig.h>
 #include <SPI.h>
 #include <MySensors.h>
+#include <Heartbeat.h>
 #include <Bounce2.h>
 #include <Wire.h> 
 #include <LiquidCrystal_I2C.h>
@@ -42,6 +43,7 @@
 #define SENSOR_ID_LCD 0
 
 #define HEARTBEAT_INTERVAL 30000
+#define HEARTBEAT_MAX_INTERVAL 240000
 
 // LCD wiring:
 // - VCC: 5V
@@ -56,8 +58,8 @@ LiquidCrystal_I2C lcd(0x3F,16,2); // set the LCD address to 0x27 for a 16 chars
 const unsigned long lcdOnDurationMillis = 5000;
 // Scheduled LCD backlight off time
 unsigned long lcdOffMillis = 0;
-// Scheduled heartbeat time
-unsigned long heartbeatMillis = 0;
+// Heartbeat, suppressed while station states are being reported
+Heartbeat heartbeat(HEARTBEAT_INTERVAL, HEARTBEAT_MAX_INTERVAL);
 // The maximum watering time limit, in case the controller is down or lost connectivity
 const unsigned long maxWaterDuration = 30L * 60L * 1000L;
 // Scheduled off time for each station
@@ -135,10 +137,7 @@ void loop()
         Serial.println("Turn off backlight");
         lcdOffMillis = 0;
     }
-    if (millis() > heartbeatMillis) {
-        sendHeartbeat();
-        heartbeatMillis += HEARTBEAT_INTERVAL;
-    }
+    heartbeat.run();
     switch (state) {
         case ready:
             if (readGreenButton()) {
@@ -296,6 +295,7 @@ void setStation(int index, int value) {
 
     // Report state to controller
     send(stationStatusMsg[index - 1].set(value ? 1 : 0));
+    heartbeat.notifySent();
 }
 
 void stopAllWatering() {
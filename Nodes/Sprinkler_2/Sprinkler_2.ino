@@ -29,6 +29,7 @@
 #include <MySensorsCustomConfig.h>
 #include <SPI.h>
 #include <MySensors.h>
+#include <Heartbeat.h>
 #include <Bounce2.h>
 #include <Wire.h> 
 #include <LiquidCrystal_I2C.h>
@@ -45,6 +46,7 @@
 #define SENSOR_ID_LCD 0
 
 #define HEARTBEAT_INTERVAL 30000
+#define HEARTBEAT_MAX_INTERVAL 240000
 
 // LCD wiring:
 // - VCC: 5V
@@ -59,8 +61,8 @@ LiquidCrystal_I2C lcd(0x3F, 16, 2); // set the LCD address to 0x3F for a 16 char
 const unsigned long LcdOnDurationMillis = 5000;
 // Scheduled LCD backlight off time
 unsigned long _lcdOffMillis = 0;
-// Scheduled heartbeat time
-unsigned long _heartbeatMillis = 0;
+// Heartbeat, suppressed while station states are being reported
+Heartbeat _heartbeat(HEARTBEAT_INTERVAL, HEARTBEAT_MAX_INTERVAL);
 // The maximum watering time limit, in case the controller is down or lost connectivity
 const unsigned long MaxWaterDuration = 30L * 60L * 1000L;
 // Scheduled off time for each station
@@ -134,10 +136,7 @@ void loop()
         Serial.println("Turn off backlight");
         _lcdOffMillis = 0;
     }
-    if (millis() > _heartbeatMillis) {
-        sendHeartbeat();
-        _heartbeatMillis += HEARTBEAT_INTERVAL;
-    }
+    _heartbeat.run();
     switch (state) {
         case ready:
             if (isGreenButtonPushed()) {
@@ -319,6 +318,7 @@ void setStation(int index, int value, bool sendState) {
         Serial.println("GW NACK");
         wait(40 * (1 << i));
     }
+    _heartbeat.notifySent();
 }
 
 void stopAllWatering() {
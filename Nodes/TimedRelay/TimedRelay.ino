@@ -20,26 +20,30 @@
  *  - A 5V low-on relay to control the outlet
  *  - An AC 110V - DC 5V buck regulator
  * 
- * TODO:
- *  - The relay state needs to be stored into the EEPROM in case there's a power outage, and the
- *    load will be powered unexpectedly because it's reset to ON state everytime the system powers
- *    on.
+ * The relay state and a running countdown are stored in the EEPROM, so a power outage neither
+ * powers the load unexpectedly nor loses the countdown. A countdown resumes with the time that was
+ * left at the last save, which happens every minute. Saves rotate through 32 slots, so a cell lasts
+ * about 6 years of nonstop countdowns instead of about 70 days.
  * 
  */
 
 // For rotary encoder with button
 #include <ClickEncoder.h>
 #include <TimerOne.h>
-// For 7-segment LCD display
-#include <SevSeg.h>
 // Use TimerFreeTone as others interfere with built-in timers
 #include <TimerFreeTone.h>
+#include <EEPROM.h>
+#include <util/crc16.h>
+#include <Countdown.h>
 
 #define SPEAKER_PIN 18
 #define RELAY_PIN 17
 #define RELAY_ON LOW
 #define RELAY_OFF HIGH
 
+#define SAVED_STATE_ADDRESS 0
+#define SAVED_STATE_SLOTS 32 // Below 128, so the newest sequence number is found across its wrap
+
 // State of the system
 enum State {
     SETTING,
@@ -47,23 +51,65 @@ enum State {
 };
 State _state;
 
-SevSeg _sevseg; // Instantiate a seven segment controller object
+// Relay state and countdown as stored in the EEPROM. Every save goes to the next of
+// SAVED_STATE_SLOTS slots with a higher sequence number; the valid slot with the newest one is
+// the current state. The CRC is stored last, so a slot torn by a power cut is ignored.
+struct SavedState {
+    uint8_t sequence;
+    bool relayState;
+    bool counting;
+    uint32_t remainingSeconds;
+    uint16_t crc;
+};
+
+// The 4 digit 7-segment display is common cathode with the resistors on the digit pins, so it is
+// multiplexed by segment: each step lights one segment on all digits that use it. Digits are on
+// pins 2-5 (PD2-PD5), segments A-G and DP on pins 6-13 (PD6, PD7, PB0-PB5).
+#define DIGIT_COUNT 4
+#define SEGMENT_COUNT 8
+#define SEGMENT_DP 0x80
+
+// Segment codes of 0-9, segment A is bit 0
+const uint8_t DigitSegments[10] PROGMEM = {0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F};
+
+// Port values of one multiplexing step
+struct FrameStep {
+    uint8_t portD;
+    uint8_t portB;
+};
 
 ClickEncoder *_encoder;
 int16_t _lastMinutes, _minutes;
+Countdown _countdown;
 
 bool _relayState = true;
+uint8_t _savedSlot = SAVED_STATE_SLOTS - 1;
+uint8_t _savedSequence = 0;
 
 unsigned long _minutesLastUpdatedByUserMillis = 0;
-unsigned long _lastMinuteMills = 0;
+
+// Double buffered frames; loop() renders into the inactive one and then switches _activeFrame,
+// so the timer ISR never sees a half-rendered frame and only has to write two ports per step.
+FrameStep _frames[2][SEGMENT_COUNT];
+volatile uint8_t _activeFrame = 0;
+int16_t _frameMinutes = -1;
+bool _frameBlank = false;
 
 void setup() {
     Serial.begin(9600);
+    setupDisplay();
     setupEncoder();
-    setupSevSeg();
     pinMode(RELAY_PIN, OUTPUT);
+    uint32_t remainingSeconds = loadState();
     setRelay();
-    setState(SETTING);
+    if (remainingSeconds > 0) {
+        // Resume the countdown that was running when the power went out
+        _countdown.start(millis(), remainingSeconds);
+        _minutes = _countdown.remainingMinutes(millis());
+        setState(COUNTING);
+    } else {
+        setState(SETTING);
+    }
 }
 
 void loop() {
@@ -75,33 +121,79 @@ void loop() {
         processCountingState();
         break;
     }
+    publishDisplay();
 }
 
 void timerIsr() {
+    static uint8_t step = 0;
+
+    // Multiplex the next segment, keeping the UART pins (PD0, PD1) and the crystal pins (PB6, PB7)
+    const FrameStep &frameStep = _frames[_activeFrame][step];
+    PORTD = (PORTD & 0x03) | frameStep.portD;
+    PORTB = (PORTB & 0xC0) | frameStep.portB;
+    step = (step + 1) % SEGMENT_COUNT;
+
+    // Run the encoder service. It needs to be run in the timer
+    _encoder->service();
+}
+
+// Renders a new frame when the minutes or the blink phase changed
+void publishDisplay() {
     const short BlinkPeriodInMs = 2000;
     const short DelayBeforeBlinkInMs = 1000;
 
     unsigned long now = millis();
-    if (_state == SETTING && now % BlinkPeriodInMs < (BlinkPeriodInMs / 2) && now - _minutesLastUpdatedByUserMillis > DelayBeforeBlinkInMs) {
-        _sevseg.blank();
-    } else {
-        displayMinutes();
+    bool blank = _state == SETTING && now % BlinkPeriodInMs < (BlinkPeriodInMs / 2) && now - _minutesLastUpdatedByUserMillis > DelayBeforeBlinkInMs;
+    if (blank != _frameBlank || _minutes != _frameMinutes) {
+        _frameMinutes = _minutes;
+        _frameBlank = blank;
+        renderFrame(_frames[_activeFrame ^ 1], _minutes, blank);
+        // _frames is not volatile, so keep the compiler from moving its stores past the switch
+        asm volatile("" ::: "memory");
+        _activeFrame ^= 1;
     }
-    // Run the encoder service. It needs to be run in the timer
-    _encoder->service();
 }
 
-void setupSevSeg() {
-    byte numDigits = 4;
-    byte digitPins[] = {2, 3, 4, 5};
-    byte segmentPins[] = {6, 7, 8, 9, 10, 11, 12, 13};
-    bool resistorsOnSegments = false;     // 'false' means resistors are on digit pins
-    byte hardwareConfig = COMMON_CATHODE; // See README.md for options
-    bool updateWithDelays = false;        // Default. Recommended
-    bool leadingZeros = false;            // Use 'true' if you'd like to keep the leading zeros
+void setupDisplay() {
+    for (uint8_t pin = 2; pin <= 13; pin++) {
+        pinMode(pin, OUTPUT);
+    }
+    renderFrame(_frames[_activeFrame], 0, true);
+}
 
-    _sevseg.begin(hardwareConfig, numDigits, digitPins, segmentPins, resistorsOnSegments, updateWithDelays, leadingZeros);
-    _sevseg.setBrightness(10);
+// Shows minutes as is below 120 and as H.MM from there, without leading zeros
+void renderFrame(FrameStep *frame, int16_t minutes, bool blank) {
+    uint8_t digits[DIGIT_COUNT] = {0};
+    if (!blank) {
+        int16_t number = minutes;
+        uint8_t pointDigit = DIGIT_COUNT - 1;
+        if (minutes >= 120) {
+            number = minutes / 60 * 100 + (minutes % 60);
+            pointDigit = DIGIT_COUNT - 3;
+        }
+        for (int8_t digit = DIGIT_COUNT - 1; digit >= 0; digit--) {
+            if (number > 0 || digit >= pointDigit) {
+                digits[digit] = pgm_read_byte(&DigitSegments[number % 10]);
+            }
+            number /= 10;
+        }
+        if (pointDigit < DIGIT_COUNT - 1) {
+            digits[pointDigit] |= SEGMENT_DP;
+        }
+    }
+
+    for (uint8_t segment = 0; segment < SEGMENT_COUNT; segment++) {
+        // The segment pin goes high, and so do the cathodes of the digits that do not show it
+        uint16_t segmentBit = 1 << (segment + 6);
+        uint8_t digitBits = 0;
+        for (uint8_t digit = 0; digit < DIGIT_COUNT; digit++) {
+            if (!(digits[digit] & (1 << segment))) {
+                digitBits |= 1 << (digit + 2);
+            }
+        }
+        frame[segment].portD = (segmentBit & 0xC0) | digitBits;
+        frame[segment].portB = segmentBit >> 8;
+    }
 }
 
 void setupEncoder() {
@@ -115,23 +207,9 @@ void setupEncoder() {
     _lastMinutes = -1;
 }
 
-void displayMinutes() {
-    if (_minutes < 120) {
-        _sevseg.setNumber(_minutes);
-    } else {
-        _sevseg.setNumber(_minutes / 60 * 100 + (_minutes % 60), 2);
-    }
-    _sevseg.refreshDisplay(); // Must run repeatedly
-}
-
 void processCountingState() {
-    const unsigned long MinuteInMs = 60 * 1000L;
     unsigned long now = millis();
-    if (now - _lastMinuteMills >= MinuteInMs) {
-        _minutes--;
-        _lastMinuteMills = now;
-    }
-    if (_minutes <= 0) {
+    if (_countdown.expired(now)) {
         // Time's out
         _minutes = 0;
         flipRelay();
@@ -141,10 +219,16 @@ void processCountingState() {
         setState(SETTING);
         return;
     }
+    int16_t minutes = _countdown.remainingMinutes(now);
+    if (minutes != _minutes) {
+        _minutes = minutes;
+        saveState();
+    }
 
     ClickEncoder::Button b = _encoder->getButton();
     switch (b) {
     case ClickEncoder::Clicked:
+        // Stop; the remaining minutes become the new setting
         setState(SETTING);
         break;
     case ClickEncoder::DoubleClicked:
@@ -187,11 +271,15 @@ void setState(State newState) {
     _state = newState;
     switch (newState) {
     case SETTING:
+        _countdown.stop();
         break;
     case COUNTING:
-        _lastMinuteMills = millis();
+        if (!_countdown.running()) {
+            _countdown.start(millis(), _minutes * 60UL);
+        }
         break;
     }
+    saveState();
 }
 
 void flipRelay() {
@@ -199,6 +287,49 @@ void flipRelay() {
     Serial.print("Turning relay ");
     Serial.println(_relayState ? "ON" : "OFF");
     setRelay();
+    saveState();
+}
+
+// CRC-16/CCITT of all fields but the CRC itself
+uint16_t savedStateCrc(const SavedState &saved) {
+    const uint8_t *bytes = (const uint8_t *)&saved;
+    uint16_t crc = 0xFFFF;
+    for (uint8_t i = 0; i < offsetof(SavedState, crc); i++) {
+        crc = _crc_ccitt_update(crc, bytes[i]);
+    }
+    return crc;
+}
+
+// Restores the relay state and returns the seconds left of a countdown that was running, if any
+uint32_t loadState() {
+    SavedState newest;
+    bool found = false;
+    for (uint8_t slot = 0; slot < SAVED_STATE_SLOTS; slot++) {
+        SavedState saved;
+        EEPROM.get(SAVED_STATE_ADDRESS + slot * sizeof(SavedState), saved);
+        if (saved.crc == savedStateCrc(saved) && (!found || (int8_t)(saved.sequence - newest.sequence) > 0)) {
+            newest = saved;
+            found = true;
+            _savedSlot = slot;
+        }
+    }
+    if (!found) {
+        return 0;
+    }
+    _savedSequence = newest.sequence;
+    _relayState = newest.relayState;
+    return newest.counting ? newest.remainingSeconds : 0;
+}
+
+void saveState() {
+    SavedState saved;
+    saved.sequence = ++_savedSequence;
+    saved.relayState = _relayState;
+    saved.counting = _countdown.running();
+    saved.remainingSeconds = _countdown.remainingSeconds(millis());
+    saved.crc = savedStateCrc(saved);
+    _savedSlot = (_savedSlot + 1) % SAVED_STATE_SLOTS;
+    EEPROM.put(SAVED_STATE_ADDRESS + _savedSlot * sizeof(SavedState), saved);
 }
 
 void setRelay() {
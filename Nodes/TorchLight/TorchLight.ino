@@ -6,6 +6,7 @@
 #include <MySensorsCommon.h>
 #include <DhtSensor.h>
 #include <DimmerSensor.h>
+#include <SensorRegistry.h>
 
 #define CHILD_ID_DIMMER               0
 #define CHILD_ID_TEMPERATURE          1
@@ -21,16 +22,26 @@
 const uint64_t UpdateInterval = 30000;
 unsigned long _nextUpdateMillis = 0;
 
+// The LED does not support dimming, so it's either fully on or off
+class TorchSensor : public DimmerSensor {
+    public:
+        TorchSensor(uint8_t pin, uint8_t sensorId, MessageSender messageSender)
+            : DimmerSensor(pin, sensorId, messageSender) {}
+
+        uint8_t coerce(uint8_t percentage) {
+            return percentage >= 50 ? 100 : 0;
+        }
+};
+
 MessageSender _messageSender;
 DhtSensor _dhtSensor(DHT_PIN, CHILD_ID_TEMPERATURE, CHILD_ID_HUMIDITY, _messageSender);
-DimmerSensor _dimmerSensor(LED_PIN, CHILD_ID_DIMMER, _messageSender);
+TorchSensor _dimmerSensor(LED_PIN, CHILD_ID_DIMMER, _messageSender);
 ISensor* _sensors[2] = { &_dimmerSensor, &_dhtSensor };
+SensorRegistry<CHILD_ID_HUMIDITY> _sensorRegistry(_sensors);
 
 void setup() {
     Serial.println("Setting up sensors...");
-    for (ISensor* sensor : _sensors) {
-        sensor->setup();
-    }
+    _sensorRegistry.setup();
 }
 
 void presentation() {
@@ -59,18 +70,6 @@ void receive(const MyMessage &message) {
     if (_messageSender.handleAck(message)) {
         return;
     }
-    if (message.type == V_PERCENTAGE && message.sensor == CHILD_ID_DIMMER) {
-        uint8_t value = message.getByte();
-        Serial.print("Incoming dimmer value: ");
-        Serial.println(value);
-        // The LED does not support dimming
-        if (value >= 50) {
-            value = 100;
-        }
-        else {
-            value = 0;
-        }
-        _dimmerSensor.set(value);
-    }
+    _sensorRegistry.receive(message);
 }
 
@@ -38,90 +38,60 @@
 #include <MySensorsCustomConfig.h>
 #include <SPI.h>
 #include <MySensors.h>
+#include <ControlGroup.h>
+#include <Heartbeat.h>
 #include <Bounce2.h>
 
-#define RELAY_PIN_1  3  // Arduino Digital I/O pin number for first relay (second on pin+1 etc)
+#define RELAY_PIN_1  3  // Arduino Digital I/O pin number for the relay
 #define SENSOR_ID_1 1
-#define NUMBER_OF_RELAYS 1 // Total number of attached relays
-#define RELAY_ON LOW  // GPIO value to write to turn on attached relay
-#define RELAY_OFF HIGH // GPIO value to write to turn off attached relay
-#define BUTTON_ON LOW
-#define BUTTON_OFF HIGH
 #define BUTTON_PIN 4
 #define LED_PIN 5
-#define LED_PIN_ON HIGH
-#define LED_PIN_OFF LOW
 
 #define HEARTBEAT_INTERVAL 30000
-unsigned long nextHeartbeatMillis = 0;
+#define HEARTBEAT_MAX_INTERVAL 240000
+bool sendState();
+Heartbeat heartbeat(HEARTBEAT_INTERVAL, HEARTBEAT_MAX_INTERVAL, sendState);
 
-MyMessage msgState1(SENSOR_ID_1, V_LIGHT);
+// Low-on relay, with the LED mirroring the relay state
+typedef ControlGroup<Relay<SENSOR_ID_1, RELAY_PIN_1, RelayMode::Latch, LOW, LED_PIN>> Heater;
+Heater heater;
+typedef ControlGroups<ControlGroupRef<Heater, heater>> Relays;
 
-int buttonOldVal = -1;
 Bounce button = Bounce();
 
 void before() { 
     Serial.println("Initializing...");
-    pinMode(RELAY_PIN_1, OUTPUT);
-    pinMode(LED_PIN, OUTPUT);
-    // Set relay to last known state (using eeprom storage) 
-    setRelay(loadState(SENSOR_ID_1));
+    Relays::setup();
     
     button.attach(BUTTON_PIN, INPUT_PULLUP);
     button.interval(5);
-
-    nextHeartbeatMillis = millis() + HEARTBEAT_INTERVAL;
 }
 
 void presentation()  
 {   
     // Send the sketch version information to the gateway and Controller
-    sendSketchInfo("Water heater", "3.0");
-    // Register sensor to gw (they will be created as child devices)
-    present(SENSOR_ID_1, S_LIGHT);
+    sendSketchInfo("Water heater", "3.1");
+    Relays::present();
 }
 
 void loop() 
 {
     if (isButtonPushed()) {
-        setState(!loadState(SENSOR_ID_1));
-    }
-    unsigned long now = millis();
-    if (now >= nextHeartbeatMillis) {
-        nextHeartbeatMillis = now + HEARTBEAT_INTERVAL;
-        #ifdef MY_DEBUG
-        Serial.print("Sending status as heartbeat.");
-        #endif
+        heater.relay().set(!heater.relay().state());
         sendState();
     }
+    heartbeat.run();
 }
 
 void receive(const MyMessage &message) {
-    if (message.type == V_LIGHT && message.sensor == SENSOR_ID_1) {
-        setState(message.getBool());
+    if (Relays::receive(message)) {
+        heartbeat.notifySent();
     }
 }
 
-void setState(bool state) {
-    Serial.print("Setting sensor state to: ");
-    Serial.println(state);
-    // Change relay state
-    setRelay(state);
-    // Store state in eeprom
-    saveState(SENSOR_ID_1, state);
-    sendState();
-}
-
-void setRelay(bool state) {
-    digitalWrite(RELAY_PIN_1, state ? RELAY_ON : RELAY_OFF);
-    digitalWrite(LED_PIN, state ? LED_PIN_ON : LED_PIN_OFF);
-}
-
-void sendState() {
-    bool state = loadState(SENSOR_ID_1);
-    Serial.print("Sending state: ");
-    Serial.println(state);
-    send(msgState1.set(state));
+bool sendState() {
+    heartbeat.notifySent();
+    return Relays::sendState();
 }
 
 int isButtonPushed() {
@@ -1,30 +1,52 @@
 /**
  * This project turns on the water pump intermittently (7 min on, then 23 min off, and so on).
+ * The on and off times can be changed from the controller (V_VAR1 / V_VAR2 in minutes) and are
+ * kept in EEPROM; the pump keeps cycling when the gateway can't be reached. See DutyCycleRelay.h.
  */
+#define MY_NODE_ID 57
 
-const short _outPin = 3;
+// Start the pump schedule even if the gateway can't be reached at boot
+#define MY_TRANSPORT_WAIT_READY_MS 10000
 
-bool _currentState = true;
-unsigned long _nextToggleMillis = 0;
+#include <MySensorsCommon.h>
+#include <DutyCycleRelay.h>
+#include <SensorRegistry.h>
 
-unsigned long _offMillis = 23 * 60 * 1000L;
-unsigned long _onMillis = 7 * 60 * 1000L;
+#define         CHILD_ID_PUMP                 0
+/************************Hardware Related Macros************************************/
+#define         PUMP_PIN                     (3)
+// First position of the on/off times in the user EEPROM area
+#define         PUMP_EEPROM_POSITION         (0)
+
+// Default times until the controller sets others
+const uint16_t OnMinutes = 7;
+const uint16_t OffMinutes = 23;
+
+// it's a low-trigger relay
+DutyCycleRelay<LOW> _pump(PUMP_PIN, CHILD_ID_PUMP, PUMP_EEPROM_POSITION, OnMinutes, OffMinutes);
+ISensor* _sensors[1] = { &_pump };
+SensorRegistry<CHILD_ID_PUMP> _sensorRegistry(_sensors);
 
 void setup() {
-    pinMode(_outPin, OUTPUT);
-    pinMode(LED_BUILTIN, OUTPUT);
-    digitalWrite(_outPin, !_currentState);
-    digitalWrite(LED_BUILTIN, _currentState);
-    _nextToggleMillis = millis() + _onMillis;
+    Serial.println("Setting up sensors...");
+    _sensorRegistry.setup();
+}
+
+void presentation() {
+    // Send the sketch version information to the gateway and Controller
+    sendSketchInfo("Water Pump Control", "2.0");
+
+    for (ISensor* sensor : _sensors) {
+        sensor->present();
+    }
 }
 
 void loop() {
-    unsigned long now = millis();
-    if (now > _nextToggleMillis) {
-        _currentState = !_currentState;
-        // it's a low-trigger relay
-        digitalWrite(_outPin, !_currentState);
-        digitalWrite(LED_BUILTIN, _currentState);
-        _nextToggleMillis += _currentState ? _onMillis : _offMillis;
+    for (ISensor* sensor : _sensors) {
+        sensor->report();
     }
 }
+
+void receive(const MyMessage &message) {
+    _sensorRegistry.receive(message);
+}
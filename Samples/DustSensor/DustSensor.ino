@@ -28,9 +28,14 @@
  * connect the sensor as follows :
  * 
  *   VCC       >>> 5V
- *   A         >>> A0
+ *   A         >>> A1
+ *   LED       >>> D2
  *   GND       >>> GND
  *
+ * The LED is pulsed for 320us every 10ms and the output is sampled 280us into each pulse, as
+ * the datasheet requires. Timer1 and the ADC interrupt run the pulses and samples, so the node
+ * stays awake instead of sleeping between reports (ATmega328 and compatible).
+ *
  * Based on: http://www.dfrobot.com/wiki/index.php/Sharp_GP2Y1010AU 
  * Authors: Cyrille Médard de Chardon (serialC), Christophe Trefois (Trefex)
  * 
@@ -50,31 +55,83 @@
 
 #define CHILD_ID_DUST 0
 #define DUST_SENSOR_ANALOG_PIN 1
+#define DUST_SENSOR_LED_PIN 2   // Active low
+
+#define PULSE_PERIOD_MICROS 10000  // One LED pulse and sample every 10ms
+#define PULSE_WIDTH_MICROS 320
+#define SAMPLING_TIME_MICROS 280
+// An auto triggered conversion holds its input 2 ADC clocks after the trigger (16us at clock / 128
+// and 16MHz); 1.5 clocks only applies to normal conversions
+#define ADC_HOLD_DELAY_MICROS (2 * 128 * 1000000.0 / F_CPU)
+#define AVERAGE_SHIFT 8            // Running average over about 2^8 samples (2.56s)
+#define SETTLE_SAMPLES (4 << AVERAGE_SHIFT) // Samples before the first report
 
-unsigned long SLEEP_TIME = 30*1000; // Sleep time between reads (in milliseconds)
+unsigned long REPORT_INTERVAL = 30*1000; // Time between reports (in milliseconds)
 //VARIABLES
-int val = 0;           // variable to store the value coming from the sensor
-float valDUST =0.0;
 float lastDUST =0.0;
-int samplingTime = 280;
-int deltaTime = 40;
-int sleepTime = 9680;
-float voMeasured = 0;
 float calcVoltage = 0;
 float dustDensity = 0;
+unsigned long lastReportMillis = 0;
+
+// Written by the ADC ISR
+volatile uint32_t dustAverage = 0;    // Running average of the samples, fixed point with AVERAGE_SHIFT fraction bits
+volatile uint16_t sampleCount = 0;   // Samples taken, up to SETTLE_SAMPLES
+
+// LED pin registers, looked up once so the ISRs do not need digitalWrite()
+volatile uint8_t* ledPort;
+uint8_t ledMask;
 
 MyMessage dustMsg(CHILD_ID_DUST, V_LEVEL);
 
+void setup() {
+  pinMode(DUST_SENSOR_LED_PIN, OUTPUT);
+  digitalWrite(DUST_SENSOR_LED_PIN, HIGH);
+  ledPort = portOutputRegister(digitalPinToPort(DUST_SENSOR_LED_PIN));
+  ledMask = digitalPinToBitMask(DUST_SENSOR_LED_PIN);
+
+  // ADC: AVcc reference, clock / 128, auto trigger on Timer1 compare match B, conversion complete interrupt
+  ADMUX = bit(REFS0) | DUST_SENSOR_ANALOG_PIN;
+  ADCSRB = bit(ADTS2) | bit(ADTS0);
+  ADCSRA = bit(ADEN) | bit(ADATE) | bit(ADIE) | bit(ADPS2) | bit(ADPS1) | bit(ADPS0);
+
+  // Timer1: CTC mode with ICR1 as top, clock / 8 (0.5us per tick at 16MHz). The pulse starts at
+  // top (input capture interrupt), the conversion is triggered by compare match B in hardware
+  // and the pulse ends at compare match A.
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = 0;
+  TCNT1 = 0;
+  ICR1 = (F_CPU / 8 / 1000000UL) * PULSE_PERIOD_MICROS - 1;
+  OCR1A = (F_CPU / 8 / 1000000UL) * PULSE_WIDTH_MICROS;
+  OCR1B = (F_CPU / 8 / 1000000.0) * (SAMPLING_TIME_MICROS - ADC_HOLD_DELAY_MICROS);
+  TIFR1 = bit(ICF1) | bit(OCF1A) | bit(OCF1B);
+  TIMSK1 = bit(ICIE1) | bit(OCIE1A);
+  TCCR1B = bit(WGM13) | bit(WGM12) | bit(CS11);
+  interrupts();
+}
+
 void presentation() {
   // Send the sketch version information to the gateway and Controller
-  sendSketchInfo("Dust Sensor", "1.1");
+  sendSketchInfo("Dust Sensor", "2.0");
 
   // Register all sensors to gateway (they will be created as child devices)
   present(CHILD_ID_DUST, S_DUST);  
 }
 
 void loop() {    
-  uint16_t voMeasured = analogRead(DUST_SENSOR_ANALOG_PIN);// Get DUST value
+  if (millis() - lastReportMillis < REPORT_INTERVAL) {
+    return;
+  }
+
+  noInterrupts();
+  uint32_t average = dustAverage;
+  bool settled = sampleCount == SETTLE_SAMPLES;
+  interrupts();
+  if (!settled) {
+    return;
+  }
+  lastReportMillis = millis();
+  float voMeasured = (float)average / (1UL << AVERAGE_SHIFT);
 
   // 0 - 5V mapped to 0 - 1023 integer values
   // recover voltage
@@ -97,6 +154,32 @@ void loop() {
       send(dustMsg.set((int)ceil(dustDensity)));
       lastDUST = ceil(dustDensity);
   }
- 
-  sleep(SLEEP_TIME);
+}
+
+// Start of the LED pulse
+ISR(TIMER1_CAPT_vect)
+{
+  *ledPort &= ~ledMask;
+}
+
+// End of the LED pulse
+ISR(TIMER1_COMPA_vect)
+{
+  *ledPort |= ledMask;
+}
+
+// Sample taken at SAMPLING_TIME_MICROS into the pulse
+ISR(ADC_vect)
+{
+  // The auto trigger fires on the rising edge of OCF1B, which has no ISR to clear it
+  TIFR1 = bit(OCF1B);
+  uint16_t sample = ADC;
+  if (sampleCount == 0) {
+    dustAverage = (uint32_t)sample << AVERAGE_SHIFT;
+  } else {
+    dustAverage += sample - (dustAverage >> AVERAGE_SHIFT);
+  }
+  if (sampleCount < SETTLE_SAMPLES) {
+    sampleCount++;
+  }
 }
@@ -27,6 +27,10 @@
  * 	  Pin 4 of dust sensor PM2.5    -> Digital 6 (PWM) 
  * 	  Pin 5 of dust sensor          -> Ground
  * Datasheet: http://www.samyoungsnc.com/products/3-1%20Specification%20DSM501.pdf
+ *
+ * Both outputs are measured at the same time by the pin change interrupt, which adds up the
+ * time each output is low. The concentrations are computed at the end of every window, so the
+ * node keeps serving radio traffic while it measures.
 * Contributor: epierre
 **/
 
@@ -44,23 +48,28 @@
 #define CHILD_ID_DUST_PM25            1
 #define DUST_SENSOR_DIGITAL_PIN_PM10  6
 #define DUST_SENSOR_DIGITAL_PIN_PM25  3
+// Both pins have to be on port D, which shares the PCINT2 interrupt
 
-unsigned long SLEEP_TIME = 30*1000; // Sleep time between reads (in milliseconds)
 //VARIABLES
-int val = 0;           // variable to store the value coming from the sensor
-float valDUSTPM25 =0.0;
-float lastDUSTPM25 =0.0;
-float valDUSTPM10 =0.0;
-float lastDUSTPM10 =0.0;
-unsigned long duration;
+long lastDUSTPM25 = 0;
+long lastDUSTPM10 = 0;
 unsigned long starttime;
-unsigned long endtime;
 unsigned long sampletime_ms = 30000;
-unsigned long lowpulseoccupancy = 0;
-float ratio = 0;
 long concentrationPM25 = 0;
 long concentrationPM10 = 0;
 
+/// @brief Low pulse occupancy of one sensor output, accumulated by the pin change ISR
+typedef struct {
+  volatile uint8_t* input; //!< Input register of the pin
+  uint8_t mask; //!< Bit of the pin in the input register
+  volatile bool low; //!< Output currently low
+  volatile unsigned long lowStartMicros; //!< When the current low pulse started
+  volatile unsigned long lowpulseoccupancy; //!< Low time in this window, in microseconds
+} occupancy_t;
+
+occupancy_t pm10;
+occupancy_t pm25;
+
 MyMessage dustMsgPM10(CHILD_ID_DUST_PM10, V_LEVEL);
 MyMessage msgPM10(CHILD_ID_DUST_PM10, V_UNIT_PREFIX);
 MyMessage dustMsgPM25(CHILD_ID_DUST_PM25, V_LEVEL);
@@ -68,13 +77,14 @@ MyMessage msgPM25(CHILD_ID_DUST_PM25, V_UNIT_PREFIX);
 
 void setup()  
 {
-  pinMode(DUST_SENSOR_DIGITAL_PIN_PM10,INPUT);
-  pinMode(DUST_SENSOR_DIGITAL_PIN_PM25,INPUT);
+  setupOccupancy(pm10, DUST_SENSOR_DIGITAL_PIN_PM10);
+  setupOccupancy(pm25, DUST_SENSOR_DIGITAL_PIN_PM25);
+  starttime = millis();
 }
 
 void presentation() {
   // Send the sketch version information to the gateway and Controller
-  sendSketchInfo("Dust Sensor DSM501", "1.4");
+  sendSketchInfo("Dust Sensor DSM501", "2.0");
 
   // Register all sensors to gateway (they will be created as child devices)
   present(CHILD_ID_DUST_PM10, S_DUST);  
@@ -85,20 +95,26 @@ void presentation() {
 
 void loop()      
 {    
+  if (millis() - starttime < sampletime_ms) {
+    return;
+  }
+  unsigned long windowMillis = millis() - starttime;
+  starttime += windowMillis;
 
   //get PM 2.5 density of particles over 2.5 μm.
-  concentrationPM25=(long)getPM(DUST_SENSOR_DIGITAL_PIN_PM25);
+  concentrationPM25 = getPM(pm25, windowMillis);
+  //get PM 1.0 - density of particles over 1 μm.
+  concentrationPM10 = getPM(pm10, windowMillis);
+
   Serial.print("PM25: ");
   Serial.println(concentrationPM25);
   Serial.print("\n");
 
   if ((concentrationPM25 != lastDUSTPM25)&&(concentrationPM25>0)) {
-      send(dustMsgPM25.set((long)ceil(concentrationPM25)));
-      lastDUSTPM25 = ceil(concentrationPM25);
+      send(dustMsgPM25.set(concentrationPM25));
+      lastDUSTPM25 = concentrationPM25;
   }
   
-  //get PM 1.0 - density of particles over 1 μm.
-  concentrationPM10=getPM(DUST_SENSOR_DIGITAL_PIN_PM10);
   Serial.print("PM10: ");
   Serial.println(concentrationPM10);
   Serial.print("\n");
@@ -107,43 +123,68 @@ void loop()
   int temp=20; //external temperature, if you can replace this with a DHT11 or better 
   long ppmv=(concentrationPM10*0.0283168/100/1000) *  (0.08205*temp)/0.01;
   
-  if ((ceil(concentrationPM10) != lastDUSTPM10)&&((long)concentrationPM10>0)) {
+  if ((concentrationPM10 != lastDUSTPM10)&&(concentrationPM10>0)) {
       send(dustMsgPM10.set((long)ppmv));
-      lastDUSTPM10 = ceil(concentrationPM10);
+      lastDUSTPM10 = concentrationPM10;
   }
- 
-  //sleep to save on radio
-  sleep(SLEEP_TIME);
-  
 }
 
+void setupOccupancy(occupancy_t &channel, uint8_t pin)
+{
+  pinMode(pin, INPUT);
+  channel.input = portInputRegister(digitalPinToPort(pin));
+  channel.mask = digitalPinToBitMask(pin);
+  channel.low = !(*channel.input & channel.mask);
+  channel.lowStartMicros = micros();
+  channel.lowpulseoccupancy = 0;
+
+  // Enable the pin change interrupt of the pin
+  *digitalPinToPCMSK(pin) |= bit(digitalPinToPCMSKbit(pin));
+  PCIFR |= bit(digitalPinToPCICRbit(pin));
+  PCICR |= bit(digitalPinToPCICRbit(pin));
+}
 
-long getPM(int DUST_SENSOR_DIGITAL_PIN) {
+// Called from the pin change ISR, which fires for a change of either pin
+void updateOccupancy(occupancy_t &channel, unsigned long now)
+{
+  bool low = !(*channel.input & channel.mask);
+  if (low == channel.low) {
+    return;
+  }
+  channel.low = low;
+  if (low) {
+    channel.lowStartMicros = now;
+  } else {
+    channel.lowpulseoccupancy += now - channel.lowStartMicros;
+  }
+}
 
-  starttime = millis();
+ISR(PCINT2_vect)
+{
+  unsigned long now = micros();
+  updateOccupancy(pm10, now);
+  updateOccupancy(pm25, now);
+}
 
-  while (1) {
-  
-	  duration = pulseIn(DUST_SENSOR_DIGITAL_PIN, LOW);
-	  lowpulseoccupancy += duration;
-	  endtime = millis();
-	  
-	  if ((endtime-starttime) > sampletime_ms)
-	  {
-		ratio = (lowpulseoccupancy-endtime+starttime)/(sampletime_ms*10.0);  // Integer percentage 0=>100
-		long concentration = 1.1*pow(ratio,3)-3.8*pow(ratio,2)+520*ratio+0.62; // using spec sheet curve
-		//Serial.print("lowpulseoccupancy:");
-		//Serial.print(lowpulseoccupancy);
-		//Serial.print("\n");
-		//Serial.print("ratio:");
-		//Serial.print(ratio);
-		//Serial.print("\n");
-		//Serial.print("DSM501A:");
-		//Serial.println(concentration);
-		//Serial.print("\n");
-		
-		lowpulseoccupancy = 0;
-		return(concentration);	  
-	  }
-  }  
+// Returns the concentration of the window that just ended and starts the next one
+long getPM(occupancy_t &channel, unsigned long windowMillis) {
+  noInterrupts();
+  unsigned long lowpulseoccupancy = channel.lowpulseoccupancy;
+  if (channel.low) {
+    // Split a pulse in progress between this window and the next
+    unsigned long now = micros();
+    lowpulseoccupancy += now - channel.lowStartMicros;
+    channel.lowStartMicros = now;
+  }
+  channel.lowpulseoccupancy = 0;
+  interrupts();
+
+  // Low ratio in hundredths of a percent
+  long ratio = lowpulseoccupancy * 10 / windowMillis;
+  // Spec sheet curve 1.1 r^3 - 3.8 r^2 + 520 r + 0.62 in pcs/0.01cf, r in percent. Evaluated in
+  // Horner form with all values in hundredths, splitting the last product so it fits in 32 bits.
+  long a = 11 * ratio / 10 - 380;
+  long b = a * ratio / 100 + 52000;
+  long concentration = b * (ratio / 100) + b * (ratio % 100) / 100 + 62;
+  return concentration / 100;
 }
@@ -25,7 +25,8 @@
  * This sketch provides an example how to implement a distance sensor using HC-SR04 
  * Use this sensor to measure KWH and Watt of your house meeter
  * You need to set the correct pulsefactor of your meeter (blinks per KWH).
- * The sensor starts by fetching current KWH value from gateway.
+ * The pulse count is checkpointed to EEPROM, so the sensor resumes from the last
+ * checkpoint after a reset. The controller can still set it by sending VAR 1.
  * Reports both KWH and Watt back to gateway.
  *
  * Unfortunately millis() won't increment when the Arduino is in 
@@ -43,16 +44,19 @@
 
 #include <SPI.h>
 #include <MySensors.h>  
+#include <PulseCounterStore.h>
 
 #define DIGITAL_INPUT_SENSOR 3  // The digital input you attached your light sensor.  (Only 2 and 3 generates interrupt!)
 #define PULSE_FACTOR 1000       // Nummber of blinks per KWH of your meeter
 #define SLEEP_MODE false        // Watt-value can only be reported when sleep mode is false.
 #define MAX_WATT 10000          // Max watt value to report. This filetrs outliers.
 #define CHILD_ID 1              // Id of the sensor child
+#define CHECKPOINT_SLOTS 8      // Number of EEPROM slots the checkpoints rotate through
+#define CHECKPOINT_INTERVAL 600000 // Minimum time between pulse count checkpoints (in milliseconds)
+#define CHECKPOINT_CALLS 30     // ... or number of sends, as millis() stands still in sleep mode
 
 unsigned long SEND_FREQUENCY = 20000; // Minimum time between send (in milliseconds). We don't wnat to spam the gateway.
 double ppwh = ((double)PULSE_FACTOR)/1000; // Pulses per watt hour
-boolean pcReceived = false;
 volatile unsigned long pulseCount = 0;   
 volatile unsigned long lastBlink = 0;
 volatile unsigned long watt = 0;
@@ -62,13 +66,13 @@ double oldKwh;
 unsigned long lastSend;
 MyMessage wattMsg(CHILD_ID,V_WATT);
 MyMessage kwhMsg(CHILD_ID,V_KWH);
-MyMessage pcMsg(CHILD_ID,V_VAR1);
+PulseCounterStore pulseCounterStore(0, CHECKPOINT_SLOTS, CHECKPOINT_INTERVAL, CHECKPOINT_CALLS);
 
 
 void setup()  
 {  
-  // Fetch last known pulse count value from gw
-  request(CHILD_ID, V_VAR1);
+  // Resume from the last checkpointed pulse count
+  pulseCount = oldPulseCount = pulseCounterStore.load();
 
   // Use the internal pullup to be able to hook up this sketch directly to an energy meter with S0 output
   // If no pullup is used, the reported usage will be too high because of the floating pin
@@ -80,7 +84,7 @@ void setup()
 
 void presentation() {
   // Send the sketch version information to the gateway and Controller
-  sendSketchInfo("Energy Meter", "1.0");
+  sendSketchInfo("Energy Meter", "1.1");
 
   // Register this device as power sensor
   present(CHILD_ID, S_POWER);
@@ -91,7 +95,7 @@ void loop()
   unsigned long now = millis();
   // Only send values at a maximum frequency or woken up from sleep
   bool sendTime = now - lastSend > SEND_FREQUENCY;
-  if (pcReceived && (SLEEP_MODE || sendTime)) {
+  if (SLEEP_MODE || sendTime) {
     // New watt value has been calculated  
     if (!SLEEP_MODE && watt != oldWatt) {
       // Check that we dont get unresonable large watt value. 
@@ -106,19 +110,15 @@ void loop()
   
     // Pulse cout has changed
     if (pulseCount != oldPulseCount) {
-      send(pcMsg.set(pulseCount));  // Send pulse count value to gw 
-      double kwh = ((double)pulseCount/((double)PULSE_FACTOR));     
       oldPulseCount = pulseCount;
+      double kwh = ((double)oldPulseCount/((double)PULSE_FACTOR));     
       if (kwh != oldKwh) {
         send(kwhMsg.set(kwh, 4));  // Send kwh value to gw 
         oldKwh = kwh;
       }
     }    
+    pulseCounterStore.checkpoint(oldPulseCount);  // Checkpoint pulse count to EEPROM
     lastSend = now;
-  } else if (sendTime && !pcReceived) {
-    // No count received. Try requesting it again
-    request(CHILD_ID, V_VAR1);
-    lastSend=now;
   }
   
   if (SLEEP_MODE) {
@@ -128,10 +128,14 @@ void loop()
 
 void receive(const MyMessage &message) {
   if (message.type==V_VAR1) {  
-    pulseCount = oldPulseCount = message.getLong();
-    Serial.print("Received last pulse count from gw:");
-    Serial.println(pulseCount);
-    pcReceived = true;
+    // The controller overrides the stored pulse count
+    unsigned long gwPulseCount = message.getULong();
+    noInterrupts();
+    pulseCount = gwPulseCount;
+    interrupts();
+    pulseCounterStore.reset(gwPulseCount);
+    Serial.print("Received pulse count from gw:");
+    Serial.println(gwPulseCount);
   }
 }
 
@@ -1,8 +1,19 @@
 // Source: https://bitbucket.org/fmalpartida/new-liquidcrystal/wiki/Home
+//
+// Shows a line of text from the controller (V_TEXT) on each row of a 16x2 I2C LCD. Text longer
+// than a row scrolls. Only the characters that changed are sent to the LCD, a few per pass through
+// loop(), see LcdCompositor.h.
 
+// Enable and select radio type attached
+#define MY_RADIO_NRF24
+//#define MY_RADIO_RFM69
+
+#include <SPI.h>
+#include <MySensors.h>
 #include <Wire.h>
 #include <LCD.h>
 #include <LiquidCrystal_I2C.h>
+#include <LcdCompositor.h>
 
 
 #define I2C_ADDR 0x3F // <<----- Add your address here.  Find it from I2C Scanner
@@ -15,24 +26,54 @@
 #define D6_pin 6
 #define D7_pin 7
 
+#define LCD_COLUMNS 16
+#define LCD_ROWS 2
+#define SCROLL_INTERVAL 400 // Milliseconds per step of a scrolling line
+#define CHILD_ID_LINE 0 // Child IDs CHILD_ID_LINE to CHILD_ID_LINE + LCD_ROWS - 1
+
 LiquidCrystal_I2C lcd(I2C_ADDR, En_pin, Rw_pin, Rs_pin, D4_pin, D5_pin, D6_pin, D7_pin);
 LCD *myLcd = &lcd;
+LcdCompositor<LCD, LCD_COLUMNS, LCD_ROWS> compositor(lcd);
 
 void setup()
 {
     // Switch on the backlight
     //pinMode(BACKLIGHT_PIN, OUTPUT);
     //digitalWrite(BACKLIGHT_PIN, HIGH);
-    myLcd->begin(16, 2); // initialize the lcd
+    myLcd->begin(LCD_COLUMNS, LCD_ROWS); // initialize the lcd
     myLcd->setBacklightPin(BACKLIGHT_PIN, POSITIVE);
     myLcd->setBacklight(HIGH);
 
-    myLcd->home(); // go home
-    myLcd->print("Hello, ARDUINO ");
-    myLcd->setCursor(0, 1); // go to the next line
-    myLcd->print(" WORLD 2!  ");
+    // One region per row
+    for (uint8_t row = 0; row < LCD_ROWS; row++) {
+        compositor.setRegion(row, row, 0, LCD_COLUMNS, SCROLL_INTERVAL);
+    }
+    compositor.setText(0, "Hello, ARDUINO ");
+    compositor.setText(1, " WORLD 2!  ");
+
+    // Ask the controller for the current text
+    for (uint8_t row = 0; row < LCD_ROWS; row++) {
+        request(CHILD_ID_LINE + row, V_TEXT);
+    }
+}
+
+void presentation()
+{
+    sendSketchInfo("Virtual LCD", "1.1");
+    for (uint8_t row = 0; row < LCD_ROWS; row++) {
+        present(CHILD_ID_LINE + row, S_INFO);
+    }
 }
 
 void loop()
 {
-}
\ No newline at end of file
+    compositor.update(millis());
+}
+
+void receive(const MyMessage &message)
+{
+    uint8_t row = message.sensor - CHILD_ID_LINE;
+    if (message.type == V_TEXT && row < LCD_ROWS) {
+        compositor.setText(row, message.getString());
+    }
+}
@@ -20,6 +20,7 @@
  *
  * REVISION HISTORY
  * Version 1.0 - Henrik Ekblad
+ * Version 1.1 - Non-blocking knock capture, tempo and miscount tolerant matching, several stored knocks
  * 
  * DESCRIPTION
  *
@@ -41,13 +42,24 @@
  * Pin 0: Program button used for recording a new Knock (connect Pin0 -> button -> GND) 
  * Pin 1: Optional: Connect LED here (remember resisor in series)
  * Pin 2: Optional: Piezo element (for beeps). 
- * Pin 5: A sound sensor (digital output) for sensing knocks. See MySensors purchase guide. I used this: http://rover.ebay.com/rover/1/711-53200-19255-0/1?icep_ff3=2&pub=5575069610&toolid=10001&campid=5337433187&customid=&icep_item=200941260251&ipn=psmain&icep_vectorid=229466&kwid=902099&mtid=824&kw=lg 
+ * Pin 5: A sound sensor (digital output, captured by the pin change interrupt) for sensing knocks. See MySensors purchase guide. I used this: http://rover.ebay.com/rover/1/711-53200-19255-0/1?icep_ff3=2&pub=5575069610&toolid=10001&campid=5337433187&customid=&icep_item=200941260251&ipn=psmain&icep_vectorid=229466&kwid=902099&mtid=824&kw=lg 
  * Pin 4: Connects to either 1. Relay which open door or lock or 
  *                           2. transistor that opens a solenoid lock when HIGH (see adafruit guide for this option).
  *                               
  *
  * Connect radio according as usual(you can skip IRQ pin) 
  * http://www.mysensors.org/build/connect_radio 
+ *
+ * ------Knocks------
+ * Knocks are timestamped by the pin change interrupt, and loop() turns them into a knock attempt,
+ * so the radio and the lock keep being served while someone knocks. A finished attempt is compared
+ * with each stored knock in turn, one per pass through loop(). Knock times are taken relative to
+ * the length of the whole attempt, which makes the tempo irrelevant, and compared with dynamic time
+ * warping, so one extra or missed knock only costs the distance to its neighbours instead of
+ * rejecting the attempt.
+ *
+ * Up to maxStoredKnocks knocks are kept in EEPROM. Every knock recorded in programming mode takes
+ * the next slot, round robin, so recording maxStoredKnocks times replaces all of them.
  */
 
 
@@ -64,7 +76,7 @@
 
 #define CHILD_ID 99   // Id of the sensor child
 
-const byte eepromValid = 121;    // If the first byte in eeprom is this then the data is valid.
+const byte eepromValid = 122;    // If the second byte in eeprom is this then the stored knocks are valid.
  
 /*Pin definitions*/
 const int programButton = 0;   // (Digital 0) Record A New Knock button.
@@ -74,18 +86,63 @@ const int audioOut = 2;        // (Digital 2) for using the peizo as an output d
 const int lockPin = 4;         // (Digital 4) The pin that activates the relay/solenoid lock.
  
 /*Tuning constants. Changing the values below changes the behavior of the device.*/
-int threshold = 3;                 // Minimum signal from the piezo to register as a knock. Higher = less sensitive. Typical values 1 - 10
-const int rejectValue = 25;        // If an individual knock is off by this percentage of a knock we don't unlock. Typical values 10-30
-const int averageRejectValue = 15; // If the average timing of all the knocks is off by this percent we don't unlock. Typical values 5-20
+const byte knockScale = 250;       // Knock times are stored in 1/knockScale of the length of the whole knock.
+const int averageRejectValue = 8;  // If the knocks are off by more than this (in 1/knockScale of the knock length) on average we don't unlock. Typical values 5-15
+const int maxCountDifference = 1;  // Number of extra or missed knocks that are tolerated.
+const int minimumKnocks = 3;       // Fewer knocks than this are never a valid knock.
 const int knockFadeTime = 150;     // Milliseconds we allow a knock to fade before we listen for another one. (Debounce timer.)
-const int lockOperateTime = 2500;  // Milliseconds that we operate the lock solenoid latch before releasing it.
+const int lockQuietTime = 500;     // Milliseconds knocks are ignored after the lock moved, because releasing the latch can cause a vibration that will be sensed as a knock.
+const int buttonQuietTime = 250;   // Milliseconds knocks are ignored after the program button, because releasing the button can sometimes be sensed as a knock.
+const int buttonDebounceTime = 50; // Milliseconds the program button has to be stable.
 const int maximumKnocks = 20;      // Maximum number of knocks to listen for.
 const int knockComplete = 1200;    // Longest time to wait for a knock before we assume that it's finished. (milliseconds)
- 
-byte secretCode[maximumKnocks] = {50, 25, 25, 50, 100, 50, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};  // Initial setup: "Shave and a Hair Cut, two bits."
-int knockReadings[maximumKnocks];    // When someone knocks this array fills with the delays between knocks.
-int knockSensorValue = 0;            // Last reading of the knock sensor.
+const int maxStoredKnocks = 4;     // Number of knocks kept in EEPROM.
+
+/*EEPROM layout (loadState/saveState positions)*/
+const byte eepromLockStatus = 0;
+const byte eepromSignature = 1;
+const byte eepromNextSlot = 2;
+const byte eepromFirstSlot = 3;    // Each slot holds the number of knocks followed by maximumKnocks knock times.
+
+/*Stored knocks, in 1/knockScale of their length. A knock count of 0 marks an empty slot.*/
+byte storedKnocks[maxStoredKnocks][maximumKnocks];
+byte storedKnockCount[maxStoredKnocks];
+byte nextSlot = 0;
+
+/*Knock timestamps written by the pin change ISR, read by loop()*/
+const byte knockBufferSize = 8;    // Power of 2
+volatile unsigned long knockTimes[knockBufferSize];
+volatile byte knockHead = 0;
+volatile unsigned long lastKnockMillis = 0;
+byte knockTail = 0;
+
+/*The knock attempt being listened to*/
+unsigned int attemptTimes[maximumKnocks];   // Milliseconds since the first knock.
+byte attemptKnocks[maximumKnocks];          // Normalized attemptTimes.
+int attemptCount = 0;
+unsigned long attemptStartMillis = 0;
+int matchCount = 0;                         // Knocks in the finished attempt that is being matched.
+int matchSlot = -1;                         // Next stored knock to compare the finished attempt with, -1 if none.
+unsigned long quietStartMillis = 0;         // Knocks within quietMillis from here are ignored.
+unsigned long quietMillis = 0;
+
 boolean programModeActive = false;   // True if we're trying to program a new knock.
+bool buttonPressed = false;
+bool buttonReading = false;
+unsigned long buttonChangeMillis = 0;
+
+/*Blinks and beeps, played from loop()*/
+typedef struct {
+  bool led;
+  unsigned int frequency;   // Tone frequency in Hz, 0 for silence
+  unsigned int duration;    // Milliseconds
+} feedback_t;
+const int maxFeedbackSteps = 2 * maximumKnocks + 2;
+feedback_t feedback[maxFeedbackSteps];
+int feedbackCount = 0;
+int feedbackStep = 0;
+bool feedbackStarted = false;
+unsigned long feedbackStepMillis = 0;
 
 bool lockStatus;
 
@@ -99,130 +156,167 @@ void setup() {
   pinMode(programButton, INPUT);
   digitalWrite(programButton, HIGH); // Enable internal pull up 
 
-  readSecretKnock();   // Load the secret knock (if any) from EEPROM.
+  readSecretKnocks();   // Load the secret knocks (if any) from EEPROM.
   
   digitalWrite(lockPin, HIGH); // Unlock the door for a bit when we power up. For system check and to allow a way in if the key is forgotten
   delay(500);                  // Wait a short time
   
-  lockStatus = loadState(0);    // Read last lock status from eeprom
+  lockStatus = loadState(eepromLockStatus);    // Read last lock status from eeprom
   setLockState(lockStatus, true); // Now set the last known state and send it to controller 
 
-  delay(500);          // This delay is here because the solenoid lock returning to place can otherwise trigger and inadvertent knock.
+  // Timestamp knocks from the pin change interrupt of the knock sensor
+  *digitalPinToPCMSK(knockSensor) |= bit(digitalPinToPCMSKbit(knockSensor));
+  PCIFR |= bit(digitalPinToPCICRbit(knockSensor));
+  PCICR |= bit(digitalPinToPCICRbit(knockSensor));
 }
 
 void presentation()  {
-  sendSketchInfo("Secret Knock", "1.0");
+  sendSketchInfo("Secret Knock", "1.1");
   present(CHILD_ID, S_LOCK);
 }
+
+// The sensor output goes low for each knock; edges within knockFadeTime of a knock are its echo
+ISR(PCINT2_vect)
+{
+  if (digitalRead(knockSensor) != LOW) {
+    return;
+  }
+  unsigned long now = millis();
+  if (now - lastKnockMillis < knockFadeTime) {
+    return;
+  }
+  lastKnockMillis = now;
+  knockTimes[knockHead] = now;
+  knockHead = (knockHead + 1) & (knockBufferSize - 1);
+}
  
 void loop() {
-  // Listen for any knock at all.
-  knockSensorValue = digitalRead(knockSensor);
-  if (digitalRead(programButton) == LOW){  // is the program button pressed?
-    delay(100);   // Cheap debounce.
-    if (digitalRead(programButton) == LOW){ 
-      if (programModeActive == false){     // If we're not in programming mode, turn it on.
-        programModeActive = true;          // Remember we're in programming mode.
-        digitalWrite(ledPin, HIGH);        // Turn on the red light too so the user knows we're programming.
-        chirp(500, 1500);                  // And play a tone in case the user can't see the LED.
-        chirp(500, 1000);
-      } else {                             // If we are in programing mode, turn it off.
-        programModeActive = false;
-        digitalWrite(ledPin, LOW);
-        chirp(500, 1000);                  // Turn off the programming LED and play a sad note.
-        chirp(500, 1500);
-        delay(500);
-      }
-      while (digitalRead(programButton) == LOW){
-        delay(10);                         // Hang around until the button is released.
-      } 
+  unsigned long now = millis();
+  updateProgramButton(now);
+
+  // Collect the knocks timestamped since the last pass
+  while (knockTail != knockHead) {
+    unsigned long knockMillis = knockTimes[knockTail];
+    knockTail = (knockTail + 1) & (knockBufferSize - 1);
+    // Unsigned, so this stays right however long ago the quiet period was
+    if (knockMillis - quietStartMillis >= quietMillis) {
+      addKnock(knockMillis);
     }
-    delay(250);   // Another cheap debounce. Longer because releasing the button can sometimes be sensed as a knock.
   }
-  
-  
-  if (knockSensorValue == 0) {
-     if (programModeActive == true){  // Blink the LED when we sense a knock.
-       digitalWrite(ledPin, LOW);
-     } else {
-       digitalWrite(ledPin, HIGH);
-     }
-     knockDelay();
-     if (programModeActive == true){  // Un-blink the LED.
-       digitalWrite(ledPin, HIGH);
-     } else {
-       digitalWrite(ledPin, LOW);
-     }
-     listenToSecretKnock();           // We have our first knock. Go and see what other knocks are in store...
+
+  // Stop listening if there are too many knocks or there is too much time between knocks.
+  if (attemptCount > 0 && matchSlot < 0) {
+    noInterrupts();
+    unsigned long lastKnock = lastKnockMillis;
+    interrupts();
+    // The ISR may have stamped a knock after now was read, so compare the signed difference
+    if (attemptCount == maximumKnocks || (long)(now - lastKnock) >= (long)knockComplete) {
+      finishKnock();
+    }
   }
- 
-} 
- 
-// Records the timing of knocks.
-void listenToSecretKnock(){
-  int i = 0;
-  // First reset the listening array.
-  for (i=0; i < maximumKnocks; i++){
-    knockReadings[i] = 0;
+
+  if (matchSlot >= 0) {
+    matchNextSlot();
   }
-  
-  int currentKnockNumber = 0;               // Position counter for the array.
-  int startTime = millis();                 // Reference for when this knock started.
-  int now = millis();   
- 
-  do {                                      // Listen for the next knock or wait for it to timeout. 
-    knockSensorValue = digitalRead(knockSensor);
 
-    if (knockSensorValue == 0){                   // Here's another knock. Save the time between knocks.
-          Serial.println("knock");
+  updateFeedback(now);
+}
 
-      now=millis();
-      knockReadings[currentKnockNumber] = now - startTime;
-      currentKnockNumber ++;                             
-      startTime = now;          
- 
-       if (programModeActive==true){     // Blink the LED when we sense a knock.
-         digitalWrite(ledPin, LOW);
-       } else {
-         digitalWrite(ledPin, HIGH);
-       } 
-       knockDelay();
-       if (programModeActive == true){  // Un-blink the LED.
-         digitalWrite(ledPin, HIGH);
-       } else {
-         digitalWrite(ledPin, LOW);
-       }
-    }
- 
-    now = millis();
-  
-    // Stop listening if there are too many knocks or there is too much time between knocks.
-  } while ((now-startTime < knockComplete) && (currentKnockNumber < maximumKnocks));
+void updateProgramButton(unsigned long now) {
+  bool reading = digitalRead(programButton) == LOW;
+  if (reading != buttonReading) {
+    buttonReading = reading;
+    buttonChangeMillis = now;
+  }
+  if (buttonReading == buttonPressed || now - buttonChangeMillis < buttonDebounceTime) {
+    return;
+  }
+  buttonPressed = buttonReading;
+  quietStartMillis = now;
+  quietMillis = buttonQuietTime;
+  if (!buttonPressed) {
+    return;
+  }
+  programModeActive = !programModeActive;
+  clearFeedback();
+  if (programModeActive) {             // Turn on the red light too so the user knows we're programming.
+    addChirp(500, 1500);               // And play a tone in case the user can't see the LED.
+    addChirp(500, 1000);
+  } else {                             // Turn off the programming LED and play a sad note.
+    addChirp(500, 1000);
+    addChirp(500, 1500);
+  }
+}
+
+void addKnock(unsigned long knockMillis) {
+  Serial.println("knock");
+  if (attemptCount == 0) {
+    attemptStartMillis = knockMillis;
+  }
+  if (attemptCount < maximumKnocks) {
+    attemptTimes[attemptCount++] = knockMillis - attemptStartMillis;
+  }
+  if (feedbackStep == feedbackCount) {   // Blink the LED when we sense a knock.
+    clearFeedback();
+    addFeedback(!idleLed(), 0, knockFadeTime);
+  }
+}
+
+// Normalizes the knock times to the length of the attempt, then records or matches it
+void finishKnock() {
   Serial.println("end");
+  int count = attemptCount;
+  attemptCount = 0;
+  if (count < minimumKnocks) {
+    failedKnock();
+    return;
+  }
+  unsigned long length = attemptTimes[count - 1];
+  for (int i = 0; i < count; i++) {
+    attemptKnocks[i] = (attemptTimes[i] * (unsigned long)knockScale + length / 2) / length;
+  }
 
-  //we've got our knock recorded, lets see if it's valid
-  if (programModeActive == false){           // Only do this if we're not recording a new knock.
-    if (validateKnock() == true){
-      // Lock/unlock door
-      chirp(500, 1500);                  // And play a tone in case the user can't see the LED.
-      chirp(500, 1000);
-      setLockState(!lockStatus, true); 
-    } else {
-      Serial.println("fail unlock");
-
-      // knock is invalid. Blink the LED as a warning to others.
-      for (i=0; i < 4; i++){          
-        digitalWrite(ledPin, HIGH);
-        delay(50);
-        digitalWrite(ledPin, LOW);
-        delay(50);
-      }
-    }
-  } else { // If we're in programming mode we still validate the lock because it makes some numbers we need, we just don't do anything with the return.
-    validateKnock();
+  if (programModeActive) {
+    saveSecretKnock(nextSlot, attemptKnocks, count);
+    nextSlot = (nextSlot + 1) % maxStoredKnocks;
+    saveState(eepromNextSlot, nextSlot);
+    programModeActive = false;
+    playbackKnock(attemptKnocks, count, length);
+    return;
+  }
+  matchCount = count;
+  matchSlot = 0;
+}
+
+// Compares the finished attempt with one stored knock; called once per loop() until one matches
+void matchNextSlot() {
+  int slot = matchSlot;
+  if (validateKnock(storedKnocks[slot], storedKnockCount[slot], attemptKnocks, matchCount)) {
+    Serial.print("matched knock ");
+    Serial.println(slot);
+    matchSlot = -1;
+    clearFeedback();
+    addChirp(500, 1500);
+    addChirp(500, 1000);
+    setLockState(!lockStatus, true); 
+    return;
+  }
+  matchSlot++;
+  if (matchSlot == maxStoredKnocks) {
+    matchSlot = -1;
+    failedKnock();
+  }
+}
+
+void failedKnock() {
+  Serial.println("fail unlock");
+  // knock is invalid. Blink the LED as a warning to others.
+  clearFeedback();
+  for (int i = 0; i < 4; i++) {
+    addFeedback(true, 0, 50);
+    addFeedback(false, 0, 50);
   }
 }
- 
  
 // Unlocks the door.
 void setLockState(bool state, bool doSend){
@@ -235,136 +329,145 @@ void setLockState(bool state, bool doSend){
   
   digitalWrite(ledPin, state);
   digitalWrite(lockPin, state);
-  saveState(0,state);
+  saveState(eepromLockStatus, state);
   lockStatus = state;
-  delay(500);   // This delay is here because releasing the latch can cause a vibration that will be sensed as a knock.
+  quietStartMillis = millis();
+  quietMillis = lockQuietTime;
 }
  
-// Checks to see if our knock matches the secret.
-// Returns true if it's a good knock, false if it's not.
-boolean validateKnock(){
-  int i = 0;
- 
-  int currentKnockCount = 0;
-  int secretKnockCount = 0;
-  int maxKnockInterval = 0;               // We use this later to normalize the times.
-  
-  for (i=0;i<maximumKnocks;i++){
-    if (knockReadings[i] > 0){
-      currentKnockCount++;
-    }
-    if (secretCode[i] > 0){         
-      secretKnockCount++;
-    }
-    
-    if (knockReadings[i] > maxKnockInterval){   // Collect normalization data while we're looping.
-      maxKnockInterval = knockReadings[i];
-    }
+// Dynamic time warping distance between two knocks: the smallest sum of time differences over
+// any alignment of their knocks in order, so an extra or missed knock adds only its distance to
+// the nearest knock of the other one. Runs in one row of maximumKnocks + 1 cells.
+unsigned int knockDistance(const byte *a, int aCount, const byte *b, int bCount) {
+  unsigned int row[maximumKnocks + 1];
+  row[0] = 0;
+  for (int j = 1; j <= bCount; j++) {
+    row[j] = 0xFFFF;
   }
-  
-  // If we're recording a new knock, save the info and get out of here.
-  if (programModeActive == true){
-      for (i=0; i < maximumKnocks; i++){ // Normalize the time between knocks. (the longest time = 100)
-        secretCode[i] = map(knockReadings[i], 0, maxKnockInterval, 0, 100); 
-      }
-      saveSecretKnock();                // save the result to EEPROM
-      programModeActive = false;
-      playbackKnock(maxKnockInterval);
-      return false;
+  for (int i = 1; i <= aCount; i++) {
+    unsigned int diagonal = row[0];
+    row[0] = 0xFFFF;
+    for (int j = 1; j <= bCount; j++) {
+      unsigned int above = row[j];
+      unsigned int best = min(diagonal, min(above, row[j - 1]));
+      diagonal = above;
+      row[j] = best == 0xFFFF ? best : best + abs((int)a[i - 1] - (int)b[j - 1]);
+    }
   }
-  
-  if (currentKnockCount != secretKnockCount){  // Easiest check first. If the number of knocks is wrong, don't unlock.
+  return row[bCount];
+}
+
+// Checks to see if a knock matches a stored one.
+// Returns true if it's a good knock, false if it's not.
+boolean validateKnock(const byte *secret, int secretCount, const byte *knock, int knockCount) {
+  if (secretCount == 0 || abs(knockCount - secretCount) > maxCountDifference) {
     return false;
   }
-  
-  /*  Now we compare the relative intervals of our knocks, not the absolute time between them.
-      (ie: if you do the same pattern slow or fast it should still open the door.)
+  /*  We compare the knock times relative to the length of the whole knock, not the absolute
+      times. (ie: if you do the same pattern slow or fast it should still open the door.)
       This makes it less picky, which while making it less secure can also make it
       less of a pain to use if you're tempo is a little slow or fast. 
   */
-  int totaltimeDifferences = 0;
-  int timeDiff = 0;
-  for (i=0; i < maximumKnocks; i++){    // Normalize the times
-    knockReadings[i]= map(knockReadings[i], 0, maxKnockInterval, 0, 100);      
-    timeDiff = abs(knockReadings[i] - secretCode[i]);
-    if (timeDiff > rejectValue){        // Individual value too far out of whack. No access for this knock!
-      return false;
-    }
-    totaltimeDifferences += timeDiff;
-  }
-  // It can also fail if the whole thing is too inaccurate.
-  if (totaltimeDifferences / secretKnockCount > averageRejectValue){
-    return false; 
-  }
-  
-  return true;
+  unsigned int distance = knockDistance(secret, secretCount, knock, knockCount);
+  return distance <= (unsigned int)averageRejectValue * max(secretCount, knockCount);
 }
  
- 
-// reads the secret knock from EEPROM. (if any.)
-void readSecretKnock(){
-  byte reading;
-  reading = loadState(1);
-  if (reading == eepromValid){    // only read EEPROM if the signature byte is correct.
-    for (int i=0; i < maximumKnocks ;i++){
-      secretCode[i] =  loadState(i+2);
+// reads the secret knocks from EEPROM. (if any.)
+void readSecretKnocks(){
+  if (loadState(eepromSignature) != eepromValid) {
+    // Initial setup: "Shave and a Hair Cut, two bits."
+    const byte shaveAndAHaircut[] = {0, 42, 63, 83, 125, 208, 250};
+    saveState(eepromNextSlot, 1);
+    saveSecretKnock(0, shaveAndAHaircut, sizeof(shaveAndAHaircut));
+    for (int slot = 1; slot < maxStoredKnocks; slot++) {
+      saveSecretKnock(slot, NULL, 0);
+    }
+    saveState(eepromSignature, eepromValid);  // all good. Write the signature so we'll know it's all good.
+  }
+  nextSlot = loadState(eepromNextSlot) % maxStoredKnocks;
+  for (int slot = 0; slot < maxStoredKnocks; slot++) {
+    byte position = eepromFirstSlot + slot * (maximumKnocks + 1);
+    storedKnockCount[slot] = min(loadState(position), maximumKnocks);
+    for (int i = 0; i < maximumKnocks; i++) {
+      storedKnocks[slot][i] = loadState(position + 1 + i);
     }
   }
 }
  
- 
 //saves a new pattern too eeprom
-void saveSecretKnock(){
-  saveState(1, 0); // clear out the signature. That way we know if we didn't finish the write successfully.
-  for (int i=0; i < maximumKnocks; i++){
-    saveState(i+2, secretCode[i]);
+void saveSecretKnock(int slot, const byte *knock, int count){
+  byte position = eepromFirstSlot + slot * (maximumKnocks + 1);
+  saveState(position, 0); // clear out the count. That way an unfinished write leaves an empty slot.
+  for (int i = 0; i < maximumKnocks; i++) {
+    byte value = i < count ? knock[i] : 0;
+    saveState(position + 1 + i, value);
+    storedKnocks[slot][i] = value;
   }
-  saveState(1, eepromValid);  // all good. Write the signature so we'll know it's all good.
+  saveState(position, count);
+  storedKnockCount[slot] = count;
 }
  
 // Plays back the pattern of the knock in blinks and beeps
-void playbackKnock(int maxKnockInterval){
-      digitalWrite(ledPin, LOW);
-      delay(1000);
-      digitalWrite(ledPin, HIGH);
-      chirp(200, 1800);
-      for (int i = 0; i < maximumKnocks ; i++){
-        digitalWrite(ledPin, LOW);
-        // only turn it on if there's a delay
-        if (secretCode[i] > 0){                                   
-          delay(map(secretCode[i], 0, 100, 0, maxKnockInterval)); // Expand the time back out to what it was. Roughly. 
-          digitalWrite(ledPin, HIGH);
-          chirp(200, 1800);
-        }
-      }
-      digitalWrite(ledPin, LOW);
+void playbackKnock(const byte *knock, int count, unsigned long length){
+  clearFeedback();
+  addFeedback(false, 0, 1000);
+  for (int i = 0; i < count; i++) {
+    if (i > 0) {
+      // Expand the time back out to what it was. Roughly. 
+      addFeedback(false, 0, (knock[i] - knock[i - 1]) * length / knockScale);
+    }
+    addChirp(200, 1800);
+  }
 }
- 
-// Deals with the knock delay thingy.
-void knockDelay(){
-  int itterations = (knockFadeTime / 20);      // Wait for the peak to dissipate before listening to next one.
-  for (int i=0; i < itterations; i++){
-    delay(10);
-    analogRead(knockSensor);                  // This is done in an attempt to defuse the analog sensor's capacitor that will give false readings on high impedance sensors.
-    delay(10);
-  } 
+
+bool idleLed() {
+  return programModeActive || lockStatus;
 }
- 
-// Plays a non-musical tone on the piezo.
-// playTime = milliseconds to play the tone
-// delayTime = time in microseconds between ticks. (smaller=higher pitch tone.)
-void chirp(int playTime, int delayTime){
-  long loopTime = (playTime * 1000L) / delayTime;
-  pinMode(audioOut, OUTPUT);
-  for(int i=0; i < loopTime; i++){
-    digitalWrite(audioOut, HIGH);
-    delayMicroseconds(delayTime);
-    digitalWrite(audioOut, LOW);
+
+void clearFeedback() {
+  feedbackCount = 0;
+  feedbackStep = 0;
+  feedbackStarted = false;
+}
+
+void addFeedback(bool led, unsigned int frequency, unsigned int duration) {
+  if (feedbackCount < maxFeedbackSteps) {
+    feedback[feedbackCount++] = {led, frequency, duration};
   }
-  pinMode(audioOut, INPUT);
 }
 
+// A non-musical tone with the LED on.
+// playTime = milliseconds to play the tone
+// delayTime = time in microseconds between ticks. (smaller=higher pitch tone.)
+void addChirp(unsigned int playTime, unsigned int delayTime) {
+  addFeedback(true, 1000000UL / delayTime, playTime);
+}
 
+// Steps through the queued blinks and beeps, then returns the LED to showing the lock or the programming mode
+void updateFeedback(unsigned long now) {
+  if (feedbackStep == feedbackCount) {
+    return;
+  }
+  if (feedbackStarted) {
+    if (now - feedbackStepMillis < feedback[feedbackStep].duration) {
+      return;
+    }
+    feedbackStep++;
+  }
+  feedbackStarted = true;
+  feedbackStepMillis = now;
+  if (feedbackStep == feedbackCount) {
+    noTone(audioOut);
+    digitalWrite(ledPin, idleLed());
+    return;
+  }
+  digitalWrite(ledPin, feedback[feedbackStep].led);
+  if (feedback[feedbackStep].frequency > 0) {
+    tone(audioOut, feedback[feedbackStep].frequency);
+  } else {
+    noTone(audioOut);
+  }
+}
 
 void receive(const MyMessage &message) {
   // We only expect one type of message from controller. But we better check anyway.
@@ -377,4 +480,3 @@ void receive(const MyMessage &message) {
      Serial.println(message.getBool());
    } 
 }
-
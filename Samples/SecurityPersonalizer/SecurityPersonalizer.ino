@@ -218,9 +218,13 @@ const uint8_t user_aes_key[16] = {MY_AES_KEY};
 #endif
 
 #ifndef USE_SOFT_SIGNING
+#ifdef SHA204_SWI_UART
+atsha204Class sha204; //!< ATSHA204A on the serial port given by SHA204_SWI_SERIAL
+#else
 const int sha204Pin = MY_SIGNING_ATSHA204_PIN; //!< The IO pin to use for ATSHA204A
 atsha204Class sha204(sha204Pin);
 #endif
+#endif
 
 /** @brief Print a error notice and halt the execution */
 void halt()
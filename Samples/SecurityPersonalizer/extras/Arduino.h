@@ -0,0 +1,22 @@
+// Just enough of the Arduino API to build sha204_library.cpp on the host, for Sha204CrcTest.cpp
+#pragma once
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define pgm_read_byte(address) (*(const uint8_t *)(address))
+#define pgm_read_word(address) (*(const uint16_t *)(address))
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+
+inline void pinMode(uint8_t, uint8_t) {}
+inline void digitalWrite(uint8_t, uint8_t) {}
+inline int digitalRead(uint8_t) { return HIGH; }
+inline void delay(unsigned long) {}
+inline void delayMicroseconds(unsigned int) {}
+inline unsigned long millis() { return 0; }
+inline unsigned long micros() { return 0; }
+inline void noInterrupts() {}
+inline void interrupts() {}
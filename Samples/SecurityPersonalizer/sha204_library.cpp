@@ -3,6 +3,16 @@
 #include "sha204_lib_return_codes.h"
 
 
+#ifdef SHA204_SWI_UART
+// atsha204Class Constructor
+// Feed this function the serial port whose TX and RX pins are wired to the ATSHA204's SDA pin
+
+atsha204Class::atsha204Class(HardwareSerial &serial)
+{
+	swi_serial = &serial;
+	async_state = SHA204_ASYNC_IDLE;
+}
+#else
 // atsha204Class Constructor
 // Feed this function the Arduino-ized pin number you want to assign to the ATSHA204's SDA pin
 // For AVR ARCH, this will find the DDRX, PORTX, and PINX registrs it'll need to point to to control that pin
@@ -24,7 +34,9 @@ atsha204Class::atsha204Class(uint8_t pin)
 #else
 	device_pin = pin;
 #endif
+	async_state = SHA204_ASYNC_IDLE;
 }
+#endif
 
 /* 	Puts a the ATSHA204's unique, 4-byte serial number in the response array 
 	returns an SHA204 Return code */
@@ -56,10 +68,62 @@ uint8_t atsha204Class::getSerialNumber(uint8_t * response)
 	return returnCode;
 }
 
+/*  CRC-16 as used by the ATSHA204: polynomial 0x8005, data bits fed LSB first into a
+  left-shifting register. That is the reflected CRC-16 (polynomial 0xA001) run on the
+  bit-reversed register, which lets us process a byte per table lookup. Define
+  SHA204_CRC_BITWISE to trade the 512-byte table for the slower bit-by-bit loop. */
+#ifndef SHA204_CRC_BITWISE
+// One bit of the reflected CRC, applied eight times per table entry
+static constexpr uint16_t sha204_crc_reflected_step(uint16_t crc, uint8_t bits)
+{
+  return bits == 0 ? crc : sha204_crc_reflected_step((crc & 0x0001) ? (crc >> 1) ^ 0xA001 : crc >> 1, bits - 1);
+}
+
+#define SHA204_CRC_ENTRY(i) sha204_crc_reflected_step(i, 8)
+#define SHA204_CRC_ROW(i) \
+  SHA204_CRC_ENTRY(i + 0x0), SHA204_CRC_ENTRY(i + 0x1), SHA204_CRC_ENTRY(i + 0x2), SHA204_CRC_ENTRY(i + 0x3), \
+  SHA204_CRC_ENTRY(i + 0x4), SHA204_CRC_ENTRY(i + 0x5), SHA204_CRC_ENTRY(i + 0x6), SHA204_CRC_ENTRY(i + 0x7), \
+  SHA204_CRC_ENTRY(i + 0x8), SHA204_CRC_ENTRY(i + 0x9), SHA204_CRC_ENTRY(i + 0xA), SHA204_CRC_ENTRY(i + 0xB), \
+  SHA204_CRC_ENTRY(i + 0xC), SHA204_CRC_ENTRY(i + 0xD), SHA204_CRC_ENTRY(i + 0xE), SHA204_CRC_ENTRY(i + 0xF)
+
+static const uint16_t sha204_crc_table[256] PROGMEM = {
+  SHA204_CRC_ROW(0x00), SHA204_CRC_ROW(0x10), SHA204_CRC_ROW(0x20), SHA204_CRC_ROW(0x30),
+  SHA204_CRC_ROW(0x40), SHA204_CRC_ROW(0x50), SHA204_CRC_ROW(0x60), SHA204_CRC_ROW(0x70),
+  SHA204_CRC_ROW(0x80), SHA204_CRC_ROW(0x90), SHA204_CRC_ROW(0xA0), SHA204_CRC_ROW(0xB0),
+  SHA204_CRC_ROW(0xC0), SHA204_CRC_ROW(0xD0), SHA204_CRC_ROW(0xE0), SHA204_CRC_ROW(0xF0)
+};
+
+#undef SHA204_CRC_ROW
+#undef SHA204_CRC_ENTRY
+
+// Bit-reversed nibbles, to convert between the device's and the reflected register
+static const uint8_t sha204_reversed_nibble[16] PROGMEM = {
+  0x0, 0x8, 0x4, 0xC, 0x2, 0xA, 0x6, 0xE, 0x1, 0x9, 0x5, 0xD, 0x3, 0xB, 0x7, 0xF
+};
+
+static uint8_t sha204_reverse_byte(uint8_t value)
+{
+  return (pgm_read_byte(&sha204_reversed_nibble[value & 0x0F]) << 4) | pgm_read_byte(&sha204_reversed_nibble[value >> 4]);
+}
+
+static uint16_t sha204_reverse_word(uint16_t value)
+{
+  return ((uint16_t) sha204_reverse_byte(value & 0x00FF) << 8) | sha204_reverse_byte(value >> 8);
+}
+#endif
+
 /*  Calculates CRC16 value of provided data (and optionally including provided existing CRC16 data) 
   returns the calculated CRC16 value */
 uint16_t atsha204Class::calculateAndUpdateCrc(uint8_t length, uint8_t *data, uint16_t current_crc)
 {
+#ifndef SHA204_CRC_BITWISE
+  uint16_t crc_register = current_crc ? sha204_reverse_word(current_crc) : 0;
+
+  for (uint8_t counter = 0; counter < length; counter++)
+    crc_register = (crc_register >> 8) ^ pgm_read_word(&sha204_crc_table[(uint8_t) crc_register ^ data[counter]]);
+
+  return sha204_reverse_word(crc_register);
+#else
   uint8_t counter;
   uint16_t crc_register = current_crc;
   uint16_t polynom = 0x8005;
@@ -81,8 +145,103 @@ uint16_t atsha204Class::calculateAndUpdateCrc(uint8_t length, uint8_t *data, uin
     }
   }
   return crc_register;
+#endif
+}
+
+#ifdef SHA204_SWI_UART
+/* SWI UART functions
+  Each SWI bit travels as one 7N1 frame at 230400 baud: the start bit of the frame is the start
+  pulse, and for a zero bit the second data bit is low as well. The UART does the timing and the
+  HardwareSerial interrupts buffer the frames, so interrupts stay enabled during a transfer. As TX
+  and RX share the wire, every frame we send is also received and has to be discarded. */
+
+uint8_t atsha204Class::swi_receive_frame(uint8_t *frame)
+{
+  uint32_t start_time = micros();
+
+  while (!swi_serial->available())
+  {
+    if ((uint32_t) (micros() - start_time) > SWI_UART_FRAME_TIME_OUT)
+      return SWI_FUNCTION_RETCODE_TIMEOUT;
+  }
+  *frame = (uint8_t) swi_serial->read();
+  return SWI_FUNCTION_RETCODE_SUCCESS;
+}
+
+uint8_t atsha204Class::swi_send_bytes(uint8_t count, uint8_t *buffer)
+{
+  uint8_t i, bit_mask, frame;
+  uint16_t echo_count = 0;
+
+  // Wait turn around time.
+  delayMicroseconds(RX_TX_DELAY);
+
+  for (i = 0; i < count; i++)
+  {
+    for (bit_mask = 1; bit_mask > 0; bit_mask <<= 1)
+    {
+      swi_serial->write((bit_mask & buffer[i]) ? SWI_UART_BIT_ONE : SWI_UART_BIT_ZERO);
+      echo_count++;
+
+      // Drop echoes as they come in, a command is longer than the receive buffer
+      while (swi_serial->available())
+      {
+        (void) swi_serial->read();
+        echo_count--;
+      }
+    }
+  }
+
+  // Wait for the last frames to go out, then for their echoes.
+  swi_serial->flush();
+  for (; echo_count > 0; echo_count--)
+  {
+    if (swi_receive_frame(&frame) != SWI_FUNCTION_RETCODE_SUCCESS)
+      return SWI_FUNCTION_RETCODE_TIMEOUT;
+  }
+  return SWI_FUNCTION_RETCODE_SUCCESS;
+}
+
+uint8_t atsha204Class::swi_send_byte(uint8_t value)
+{
+  return swi_send_bytes(1, &value);
 }
 
+uint8_t atsha204Class::swi_receive_bytes(uint8_t count, uint8_t *buffer)
+{
+  uint8_t status = SWI_FUNCTION_RETCODE_SUCCESS;
+  uint8_t i;
+  uint8_t bit_mask;
+  uint8_t frame;
+
+  // Receive bits and store in buffer.
+  for (i = 0; i < count; i++)
+  {
+    for (bit_mask = 1; bit_mask > 0; bit_mask <<= 1)
+    {
+      status = swi_receive_frame(&frame);
+      if (status != SWI_FUNCTION_RETCODE_SUCCESS)
+        break;
+
+      // A one bit is the bare start pulse. The device's trailing edge may land in the last data
+      // bit, so 0x7E counts as a one too, as in Atmel's UART mode code.
+      if (((frame & 0x7F) ^ SWI_UART_BIT_ONE) < 2)
+        buffer[i] |= bit_mask;  // received "one" bit
+    }
+
+    if (status != SWI_FUNCTION_RETCODE_SUCCESS)
+      break;
+  }
+
+  if (status == SWI_FUNCTION_RETCODE_TIMEOUT)
+  {
+    if (i > 0)
+    // Indicate that we timed out after having received at least one byte.
+    status = SWI_FUNCTION_RETCODE_RX_FAIL;
+  }
+  return status;
+}
+#else
 /* SWI bit bang functions */
 
 void atsha204Class::swi_set_signal_pin(uint8_t is_high)
@@ -248,14 +407,29 @@ uint8_t atsha204Class::swi_receive_bytes(uint8_t count, uint8_t *buffer)
   return status;
 }
 
+#endif
+
 /* Physical functions */
 
 uint8_t atsha204Class::sha204p_wakeup()
 {
+#ifdef SHA204_SWI_UART
+  // Start bit and seven zero data bits at the lower rate make a low pulse of about 70 us
+  swi_serial->begin(SWI_UART_WAKE_BAUD, SERIAL_7N1);
+  swi_serial->write((uint8_t) 0x00);
+  swi_serial->flush();
+  swi_serial->begin(SWI_UART_BAUD, SERIAL_7N1);
+  delay(SHA204_WAKEUP_DELAY);
+
+  // Discard the echo of the wake pulse
+  while (swi_serial->available())
+    (void) swi_serial->read();
+#else
   swi_set_signal_pin(0);
   delayMicroseconds(10*SHA204_WAKEUP_PULSE_WIDTH);
   swi_set_signal_pin(1);
   delay(SHA204_WAKEUP_DELAY);
+#endif
 
   return SHA204_SUCCESS;
 }
@@ -361,136 +535,175 @@ uint8_t atsha204Class::sha204c_resync(uint8_t size, uint8_t *response)
 
 uint8_t atsha204Class::sha204c_send_and_receive(uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer, uint8_t execution_delay, uint8_t execution_timeout)
 {
-  uint8_t ret_code = SHA204_FUNC_FAIL;
-  uint8_t ret_code_resync;
-  uint8_t n_retries_send;
-  uint8_t n_retries_receive;
-  uint8_t i;
-  uint8_t status_byte;
+  uint8_t ret_code = sha204c_submit(tx_buffer, rx_size, rx_buffer, execution_delay, execution_timeout);
+  if (ret_code != SHA204_SUCCESS)
+    return ret_code;
+
+  return sha204c_wait();
+}
+
+/* Asynchronous command execution
+  sha204c_submit sends a command and returns as soon as it is on the wire. The caller then keeps
+  calling sha204c_poll, which does not poll the device before the minimum execution time has
+  passed and returns SHA204_BUSY until the response has been received or all retries failed.
+  Only re-synchronization, which is an error path, still blocks. */
+
+uint8_t atsha204Class::sha204c_submit(uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer, uint8_t execution_delay, uint8_t execution_timeout)
+{
   uint8_t count = tx_buffer[SHA204_BUFFER_POS_COUNT];
   uint8_t count_minus_crc = count - SHA204_CRC_SIZE;
-  uint16_t execution_timeout_us = (uint16_t) (execution_timeout * 1000) + SHA204_RESPONSE_TIMEOUT;
-  volatile uint16_t timeout_countdown;
+  uint8_t ret_code;
+
+  // Only one command can be in flight.
+  if (async_state != SHA204_ASYNC_IDLE)
+    return SHA204_FUNC_FAIL;
 
   // Append CRC.
   sha204c_calculate_crc(count_minus_crc, tx_buffer, tx_buffer + count_minus_crc);
 
-  // Retry loop for sending a command and receiving a response.
-  n_retries_send = SHA204_RETRY_COUNT + 1;
+  async_tx_buffer = tx_buffer;
+  async_rx_buffer = rx_buffer;
+  async_rx_size = rx_size;
+  async_execution_delay = execution_delay;
+  async_execution_timeout = execution_timeout;
+  async_send_retries = SHA204_RETRY_COUNT + 1;
+
+  ret_code = sha204c_async_send(SHA204_FUNC_FAIL);
+  return (ret_code == SHA204_BUSY ? SHA204_SUCCESS : ret_code);
+}
 
-  while ((n_retries_send-- > 0) && (ret_code != SHA204_SUCCESS)) 
+uint8_t atsha204Class::sha204c_poll()
+{
+  uint8_t ret_code;
+  uint8_t ret_code_resync;
+  uint8_t i;
+  uint8_t status_byte;
+  unsigned long elapsed;
+
+  if (async_state == SHA204_ASYNC_IDLE)
+    return SHA204_FUNC_FAIL;
+
+  elapsed = millis() - async_start_time;
+  if (async_state == SHA204_ASYNC_EXECUTING)
   {
-    // Send command.
-    ret_code = sha204p_send_command(count, tx_buffer);
-    if (ret_code != SHA204_SUCCESS) 
+    // Wait minimum command execution time and then start polling for a response.
+    if (elapsed < async_execution_delay)
+      return SHA204_BUSY;
+    async_state = SHA204_ASYNC_POLLING;
+  }
+
+  // Reset response buffer.
+  for (i = 0; i < async_rx_size; i++)
+    async_rx_buffer[i] = 0;
+
+  // Poll for response.
+  ret_code = sha204p_receive_response(async_rx_size, async_rx_buffer);
+  if (ret_code == SHA204_RX_NO_RESPONSE)
+  {
+    if (elapsed <= (unsigned long) async_execution_delay + async_execution_timeout)
+      return SHA204_BUSY;
+
+    // We did not receive a response. Re-synchronize and send command again.
+    if (sha204c_resync(async_rx_size, async_rx_buffer) == SHA204_RX_NO_RESPONSE)
+      // The device seems to be dead in the water.
+      return sha204c_async_finish(ret_code);
+    return sha204c_async_send(ret_code);
+  }
+
+  // We see 0xFF for the count when communication got out of sync.
+  if (ret_code != SHA204_INVALID_SIZE)
+  {
+    // We received a response of valid size.
+    // Check the consistency of the response.
+    ret_code = sha204c_check_crc(async_rx_buffer);
+    if (ret_code == SHA204_SUCCESS)
     {
-      if (sha204c_resync(rx_size, rx_buffer) == SHA204_RX_NO_RESPONSE)
-        return ret_code; // The device seems to be dead in the water.
-      else
-        continue;
+      // Received valid response.
+      if (async_rx_buffer[SHA204_BUFFER_POS_COUNT] > SHA204_RSP_SIZE_MIN)
+        // Received non-status response. We are done.
+        return sha204c_async_finish(ret_code);
+
+      // Received status response.
+      status_byte = async_rx_buffer[SHA204_BUFFER_POS_STATUS];
+
+      // Translate the three possible device status error codes
+      // into library return codes.
+      if (status_byte == SHA204_STATUS_BYTE_PARSE)
+        return sha204c_async_finish(SHA204_PARSE_ERROR);
+      if (status_byte == SHA204_STATUS_BYTE_EXEC)
+        return sha204c_async_finish(SHA204_CMD_FAIL);
+      if (status_byte == SHA204_STATUS_BYTE_COMM)
+        // The device received the command with a communication error. Send it again.
+        return sha204c_async_send(SHA204_STATUS_CRC);
+
+      // Received status response from CheckMAC, DeriveKey, GenDig,
+      // Lock, Nonce, Pause, UpdateExtra, or Write command.
+      return sha204c_async_finish(ret_code);
     }
+  }
 
-    // Wait minimum command execution time and then start polling for a response.
-    delay(execution_delay);
-
-    // Retry loop for receiving a response.
-    n_retries_receive = SHA204_RETRY_COUNT + 1;
-    while (n_retries_receive-- > 0) 
+  // Received response of invalid size or with incorrect CRC.
+  ret_code_resync = sha204c_resync(async_rx_size, async_rx_buffer);
+  if (ret_code_resync == SHA204_SUCCESS)
+  {
+    // We did not have to wake up the device. Try receiving response again.
+    if (--async_receive_retries > 0)
     {
-      // Reset response buffer.
-      for (i = 0; i < rx_size; i++)
-        rx_buffer[i] = 0;
+      async_start_time = millis();
+      return SHA204_BUSY;
+    }
+    return sha204c_async_send(ret_code);
+  }
+  if (ret_code_resync == SHA204_RESYNC_WITH_WAKEUP)
+    // We could re-synchronize, but only after waking up the device.
+    // Re-send command.
+    return sha204c_async_send(ret_code);
 
-      // Poll for response.
-      timeout_countdown = execution_timeout_us;
-      do 
-      {
-        ret_code = sha204p_receive_response(rx_size, rx_buffer);
-        timeout_countdown -= SHA204_RESPONSE_TIMEOUT;
-      } 
-      while ((timeout_countdown > SHA204_RESPONSE_TIMEOUT) && (ret_code == SHA204_RX_NO_RESPONSE));
+  // We failed to re-synchronize.
+  return sha204c_async_finish(ret_code);
+}
 
-      if (ret_code == SHA204_RX_NO_RESPONSE) 
-      {
-        // We did not receive a response. Re-synchronize and send command again.
-        if (sha204c_resync(rx_size, rx_buffer) == SHA204_RX_NO_RESPONSE)
-          // The device seems to be dead in the water.
-          return ret_code;
-        else
-          break;
-      }
+uint8_t atsha204Class::sha204c_wait()
+{
+  uint8_t ret_code;
 
-      // Check whether we received a valid response.
-      if (ret_code == SHA204_INVALID_SIZE)
-      {
-        // We see 0xFF for the count when communication got out of sync.
-        ret_code_resync = sha204c_resync(rx_size, rx_buffer);
-        if (ret_code_resync == SHA204_SUCCESS)
-          // We did not have to wake up the device. Try receiving response again.
-          continue;
-        if (ret_code_resync == SHA204_RESYNC_WITH_WAKEUP)
-          // We could re-synchronize, but only after waking up the device.
-          // Re-send command.
-          break;
-        else
-          // We failed to re-synchronize.
-          return ret_code;
-      }
+  do
+  {
+    ret_code = sha204c_poll();
+  }
+  while (ret_code == SHA204_BUSY);
 
-      // We received a response of valid size.
-      // Check the consistency of the response.
-      ret_code = sha204c_check_crc(rx_buffer);
-      if (ret_code == SHA204_SUCCESS) 
-      {
-        // Received valid response.
-        if (rx_buffer[SHA204_BUFFER_POS_COUNT] > SHA204_RSP_SIZE_MIN)
-          // Received non-status response. We are done.
-          return ret_code;
-
-        // Received status response.
-        status_byte = rx_buffer[SHA204_BUFFER_POS_STATUS];
-
-        // Translate the three possible device status error codes
-        // into library return codes.
-        if (status_byte == SHA204_STATUS_BYTE_PARSE)
-          return SHA204_PARSE_ERROR;
-        if (status_byte == SHA204_STATUS_BYTE_EXEC)
-          return SHA204_CMD_FAIL;
-        if (status_byte == SHA204_STATUS_BYTE_COMM) 
-        {
-          // In case of the device status byte indicating a communication
-          // error this function exits the retry loop for receiving a response
-          // and enters the overall retry loop
-          // (send command / receive response).
-          ret_code = SHA204_STATUS_CRC;
-          break;
-        }
+  return ret_code;
+}
 
-        // Received status response from CheckMAC, DeriveKey, GenDig,
-        // Lock, Nonce, Pause, UpdateExtra, or Write command.
-        return ret_code;
-      }
+// (Re-)sends the submitted command; ret_code is returned if all retries are used up
+uint8_t atsha204Class::sha204c_async_send(uint8_t ret_code)
+{
+  uint8_t count = async_tx_buffer[SHA204_BUFFER_POS_COUNT];
 
-      else 
-      {
-        // Received response with incorrect CRC.
-        ret_code_resync = sha204c_resync(rx_size, rx_buffer);
-        if (ret_code_resync == SHA204_SUCCESS)
-          // We did not have to wake up the device. Try receiving response again.
-          continue;
-        if (ret_code_resync == SHA204_RESYNC_WITH_WAKEUP)
-          // We could re-synchronize, but only after waking up the device.
-          // Re-send command.
-          break;
-        else
-          // We failed to re-synchronize.
-          return ret_code;
-      } // block end of check response consistency
+  while (async_send_retries > 0)
+  {
+    async_send_retries--;
 
-    } // block end of receive retry loop
+    // Send command.
+    ret_code = sha204p_send_command(count, async_tx_buffer);
+    if (ret_code == SHA204_SUCCESS)
+    {
+      async_state = SHA204_ASYNC_EXECUTING;
+      async_receive_retries = SHA204_RETRY_COUNT + 1;
+      async_start_time = millis();
+      return SHA204_BUSY;
+    }
 
-  } // block end of send and receive retry loop
+    if (sha204c_resync(async_rx_size, async_rx_buffer) == SHA204_RX_NO_RESPONSE)
+      break; // The device seems to be dead in the water.
+  }
+  return sha204c_async_finish(ret_code);
+}
 
+uint8_t atsha204Class::sha204c_async_finish(uint8_t ret_code)
+{
+  async_state = SHA204_ASYNC_IDLE;
   return ret_code;
 }
 
@@ -568,6 +781,20 @@ uint8_t atsha204Class::sha204m_read(uint8_t *tx_buffer, uint8_t *rx_buffer, uint
 uint8_t atsha204Class::sha204m_execute(uint8_t op_code, uint8_t param1, uint16_t param2,
 			uint8_t datalen1, uint8_t *data1, uint8_t datalen2, uint8_t *data2, uint8_t datalen3, uint8_t *data3,
 			uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer)
+{
+	uint8_t ret_code = sha204m_submit(op_code, param1, param2,
+				datalen1, data1, datalen2, data2, datalen3, data3,
+				tx_size, tx_buffer, rx_size, rx_buffer);
+	if (ret_code != SHA204_SUCCESS)
+		return ret_code;
+
+	// Wait for the response.
+	return sha204c_wait();
+}
+
+uint8_t atsha204Class::sha204m_submit(uint8_t op_code, uint8_t param1, uint16_t param2,
+			uint8_t datalen1, uint8_t *data1, uint8_t datalen2, uint8_t *data2, uint8_t datalen3, uint8_t *data3,
+			uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer)
 {
 	uint8_t poll_delay, poll_timeout, response_size;
 	uint8_t *p_buffer;
@@ -690,10 +917,8 @@ uint8_t atsha204Class::sha204m_execute(uint8_t op_code, uint8_t param1, uint16_t
 		p_buffer += datalen3;
 	}
 
-	sha204c_calculate_crc(len - SHA204_CRC_SIZE, tx_buffer, p_buffer);
-
-	// Send command and receive response.
-	return sha204c_send_and_receive(&tx_buffer[0], response_size,
+	// Append CRC and send command; the response is collected by sha204c_poll.
+	return sha204c_submit(&tx_buffer[0], response_size,
 				&rx_buffer[0],	poll_delay, poll_timeout);
 }
 
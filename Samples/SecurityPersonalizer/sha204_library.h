@@ -12,6 +12,27 @@
 #define START_PULSE_TIME_OUT	(255)	//! This value is decremented while waiting for the falling edge of a start pulse.
 #define ZERO_PULSE_TIME_OUT		(26)	//! This value is decremented while waiting for the falling edge of a zero pulse.
 
+/* swi_uart_config.h */
+/* Define SHA204_SWI_UART (here or in the compiler flags, so that the library sees it too) to run
+   the single-wire interface on a hardware serial port instead of bit-banging it. The port's TX and RX pins are both wired to the device's SDA pin (TX through a
+   diode or series resistor, see the ATSHA204 datasheet). Serial1 is used unless SHA204_SWI_SERIAL
+   names another port, so boards without a second port (ATmega328P, where Serial is the debug
+   console) have to name one explicitly. */
+#ifdef SHA204_SWI_UART
+#ifndef SHA204_SWI_SERIAL
+#if defined(ARDUINO_ARCH_AVR) && !defined(HAVE_HWSERIAL1)
+#error SHA204_SWI_UART needs SHA204_SWI_SERIAL on boards without Serial1
+#endif
+#define SHA204_SWI_SERIAL		Serial1
+#endif
+#endif
+
+#define SWI_UART_BAUD			(230400)	//! one UART frame (7N1) per SWI bit
+#define SWI_UART_WAKE_BAUD		(115200)	//! a 0x00 frame at this rate holds the line low for the wake pulse
+#define SWI_UART_BIT_ONE		((uint8_t) 0x7F)	//! frame carrying a one bit: the start pulse only
+#define SWI_UART_BIT_ZERO		((uint8_t) 0x7D)	//! frame carrying a zero bit: start pulse plus zero pulse
+#define SWI_UART_FRAME_TIME_OUT	(163)	//! time to wait for the next received frame (us)
+
 /* swi_phys.h */
 
 #define SWI_FUNCTION_RETCODE_SUCCESS     ((uint8_t) 0x00) //!< Communication with device succeeded.
@@ -257,6 +278,11 @@
 
 /* from sha204_comm.h */
 
+// states of a command submitted with sha204c_submit
+#define SHA204_ASYNC_IDLE            ((uint8_t)  0)  //! no command in flight
+#define SHA204_ASYNC_EXECUTING       ((uint8_t)  1)  //! command sent, minimum execution time not over yet
+#define SHA204_ASYNC_POLLING         ((uint8_t)  2)  //! polling the device for the response
+
 #define SHA204_COMMAND_EXEC_MAX      ((uint8_t) (69.0 * CPU_CLOCK_DEVIATION_POSITIVE + 0.5))  //! maximum command delay
 #define SHA204_CMD_SIZE_MIN          ((uint8_t)  7)  //! minimum number of bytes in command (from count byte to second CRC byte)
 #ifndef SHA204_CMD_SIZE_MAX
@@ -300,13 +326,18 @@
 class atsha204Class
 {
 private:
+	#ifdef SHA204_SWI_UART
+	HardwareSerial *swi_serial;
+	uint8_t swi_receive_frame(uint8_t *frame);
+	#else
 	uint8_t device_pin;
-	#ifdef ARDUINO_ARCH_AVR
+	void swi_set_signal_pin(uint8_t is_high);
+	#endif
+	#if defined(ARDUINO_ARCH_AVR) && !defined(SHA204_SWI_UART)
 	volatile uint8_t *device_port_DDR, *device_port_OUT, *device_port_IN;
 	#endif
 	void sha204c_calculate_crc(uint8_t length, uint8_t *data, uint8_t *crc);
 	uint8_t sha204c_check_crc(uint8_t *response);
-	void swi_set_signal_pin(uint8_t is_high);
 	uint8_t swi_receive_bytes(uint8_t count, uint8_t *buffer);
 	uint8_t swi_send_bytes(uint8_t count, uint8_t *buffer);
 	uint8_t swi_send_byte(uint8_t value);
@@ -315,12 +346,32 @@ private:
 	uint8_t sha204p_send_command(uint8_t count, uint8_t * command);
 	uint8_t sha204p_sleep();
 	uint8_t sha204p_resync(uint8_t size, uint8_t *response);
+	uint8_t async_state;
+	uint8_t *async_tx_buffer;
+	uint8_t *async_rx_buffer;
+	uint8_t async_rx_size;
+	uint8_t async_execution_delay;
+	uint8_t async_execution_timeout;
+	uint8_t async_send_retries;
+	uint8_t async_receive_retries;
+	unsigned long async_start_time;
+	uint8_t sha204c_async_send(uint8_t ret_code);
+	uint8_t sha204c_async_finish(uint8_t ret_code);
 	
 
 public:
+	#ifdef SHA204_SWI_UART
+	atsha204Class(HardwareSerial &serial = SHA204_SWI_SERIAL);	// Constructor
+	#else
 	atsha204Class(uint8_t pin);	// Constructor
+	#endif
 	uint8_t sha204c_wakeup(uint8_t *response);
 	uint8_t sha204c_send_and_receive(uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer, uint8_t execution_delay, uint8_t execution_timeout);
+	// Non-blocking variant: sha204c_submit sends the command, then sha204c_poll returns SHA204_BUSY
+	// until it returns what sha204c_send_and_receive would have. Both buffers must stay valid until then.
+	uint8_t sha204c_submit(uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer, uint8_t execution_delay, uint8_t execution_timeout);
+	uint8_t sha204c_poll();
+	uint8_t sha204c_wait();
 	uint8_t sha204c_resync(uint8_t size, uint8_t *response);	
 	uint8_t sha204m_random(uint8_t * tx_buffer, uint8_t * rx_buffer, uint8_t mode);
 	uint8_t sha204m_dev_rev(uint8_t *tx_buffer, uint8_t *rx_buffer);
@@ -328,6 +379,9 @@ public:
 	uint8_t sha204m_execute(uint8_t op_code, uint8_t param1, uint16_t param2,
 			uint8_t datalen1, uint8_t *data1, uint8_t datalen2, uint8_t *data2, uint8_t datalen3, uint8_t *data3,
 			uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer);
+	uint8_t sha204m_submit(uint8_t op_code, uint8_t param1, uint16_t param2,
+			uint8_t datalen1, uint8_t *data1, uint8_t datalen2, uint8_t *data2, uint8_t datalen3, uint8_t *data3,
+			uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer);
 	uint8_t sha204m_check_parameters(uint8_t op_code, uint8_t param1, uint16_t param2,
 			uint8_t datalen1, uint8_t *data1, uint8_t datalen2, uint8_t *data2, uint8_t datalen3, uint8_t *data3,
 			uint8_t tx_size, uint8_t *tx_buffer, uint8_t rx_size, uint8_t *rx_buffer);
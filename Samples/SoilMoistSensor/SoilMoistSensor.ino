@@ -38,6 +38,7 @@
  * Connection:
  *  D6, D7: alternative powering to avoid sensor degradation
  * A0, A1: alternative resistance mesuring
+ * Timer1 and the ADC interrupt are used for sampling (ATmega328 and compatible)
  *
  *  Based on:	
  *  "Vinduino" portable soil moisture sensor code V3.00
@@ -72,29 +73,54 @@
 #include <MySensors.h>
 
 // Setting up format for reading 3 soil sensors
-#define NUM_READS 10    // Number of sensor reads for filtering
+#define NUM_READS 64    // Number of sensor read cycles to average
 #define CHILD_ID 0
 
-MyMessage msg(CHILD_ID, V_LEVEL);  
-unsigned long SLEEP_TIME = 30000; // Sleep time between reads (in milliseconds)
+// Sampling is driven by Timer1 and the ADC interrupt, see the comment above startMeasurement()
+#define STEP_MICROS 250    // One probe energizing step (one ADC conversion) per 250us
+#define SETTLE_MICROS 25   // Time the probe is energized before the conversion starts
+#define BUFFER_CYCLES 16   // Read cycles per half of the sample double buffer
 
-long buffer[NUM_READS];
-int index;
+#if NUM_READS % BUFFER_CYCLES != 0
+#error NUM_READS has to be a multiple of BUFFER_CYCLES
+#endif
 
-/// @brief Structure to be used in percentage and resistance values matrix to be filtered (have to be in pairs)
-typedef struct {
-  int moisture; //!< Moisture
-  long resistance; //!< Resistance
-} values;
+MyMessage msg(CHILD_ID, V_LEVEL);  
+unsigned long SLEEP_TIME = 30000; // Sleep time between reads (in milliseconds)
 
 const long knownResistor = 4700;  // Constant value of known resistor in Ohms
 
-int supplyVoltage;                // Measured supply voltage
-int sensorVoltage;                // Measured sensor voltage
-
-values valueOf[NUM_READS];        // Calculated moisture percentages and resistances to be sorted and filtered
-
-int i;                            // Simple index variable
+/// @brief One probe energizing step: the supply pin to drive and the analog input to convert
+typedef struct {
+  uint8_t pin; //!< Pin driven high during the conversion
+  uint8_t channel; //!< Analog input converted
+} step_t;
+
+// A read cycle is 4 steps: supply and sensor voltage of reading 1 (A1), then of reading 2 (A0).
+// Pin 6 and 7 are each driven twice per cycle, so the probe sees no DC component.
+const step_t steps[4] = {{7, 1}, {6, 1}, {6, 0}, {7, 0}};
+
+// Written by the ISRs
+volatile uint16_t samples[2][BUFFER_CYCLES][4]; // Double buffer of raw ADC values, one row per read cycle
+volatile bool bufferReady[2];                   // Set by the ADC ISR when a half is full
+volatile uint8_t fillBuffer;                    // Half the ADC ISR is writing to
+volatile uint8_t fillCycle;                     // Read cycle the ADC ISR is writing to
+volatile uint8_t step;                          // Step of the read cycle in progress
+volatile uint8_t cyclesLeft;                    // Read cycles still to be sampled
+volatile uint8_t overruns;                      // Halves overwritten before loop() read them
+
+// Supply pin registers, looked up once so the ISRs do not need digitalWrite()
+volatile uint8_t* pinPort[4];
+uint8_t pinMask[4];
+
+// Measurement in progress, advanced by loop() one buffer half at a time
+bool measuring = false;
+uint8_t readHalf;  // Half loop() reads next
+int count;         // Read cycles added to the sums so far
+long sum1;
+long sum2;
+unsigned long measureStartMicros; // Timing of the measurement, printed with the readings
+unsigned long longestPassMicros;
 
 void setup() {
   // initialize the digital pins as an output.
@@ -106,31 +132,71 @@ void setup() {
   // initialize the digital pin as an output.
   // Pin 7 is sense resistor voltage supply 2
   pinMode(7, OUTPUT);   
+
+  for (uint8_t i = 0; i < 4; i++) {
+    pinPort[i] = portOutputRegister(digitalPinToPort(steps[i].pin));
+    pinMask[i] = digitalPinToBitMask(steps[i].pin);
+  }
 }
 
 void presentation()  {
-  sendSketchInfo("Soil Moisture Sensor Reverse Polarity", "1.0");
+  sendSketchInfo("Soil Moisture Sensor Reverse Polarity", "2.0");
   present(CHILD_ID, S_HUM);  
 }
 
+// loop() never waits for the sampling: it starts a measurement, then returns until a buffer half
+// is full, adds it up while the ISRs fill the other half, and reports once NUM_READS cycles are in.
+// Radio messages are handled between the passes instead of after the whole measurement.
 void loop() {
+	unsigned long passStart = micros();
+	if (!measuring) {
+		sum1 = 0;
+		sum2 = 0;
+		count = 0;
+		readHalf = 0;
+		longestPassMicros = 0;
+		measureStartMicros = passStart;
+		startMeasurement();
+		measuring = true;
+		return;
+	}
+	if (!bufferReady[readHalf]) {
+		return;
+	}
+	count += addReadings(readHalf, sum1, sum2);
+	readHalf ^= 1;
+	unsigned long passMicros = micros() - passStart;
+	if (passMicros > longestPassMicros) {
+		longestPassMicros = passMicros;
+	}
+	if (count < NUM_READS) {
+		return;
+	}
+	stopMeasurement();
+	measuring = false;
+	unsigned long measureMicros = micros() - measureStartMicros;
+
+	long read1 = sum1 / NUM_READS;
+	long read2 = sum2 / NUM_READS;
+	long sensor1 = (read1 + read2)/2;
 
-	measure(6,7,1);
 	Serial.print ("\t");
-	Serial.println (average());
-	long read1 = average();
-
-	measure(7,6,0);
+	Serial.println (read1);
 	Serial.print ("\t");
-	Serial.println (average());
-	long read2= average();
-
-	long sensor1 = (read1 + read2)/2;
-
+	Serial.println (read2);
 	Serial.print ("resistance bias =" );
 	Serial.println (read1-read2);
 	Serial.print ("sensor bias compensated value = ");
 	Serial.println (sensor1);
+	// Time loop() was busy with a buffer half at most, against the whole measurement
+	Serial.print ("measurement us = ");
+	Serial.print (measureMicros);
+	Serial.print (", longest loop pass us = ");
+	Serial.println (longestPassMicros);
+	if (overruns > 0) {
+		Serial.print ("buffer overruns = ");
+		Serial.println (overruns);
+	}
 	Serial.println ();
 	
 	//send back the values
@@ -139,52 +205,104 @@ void loop() {
     sleep(SLEEP_TIME);
 }
 
-void measure (int phase_b, int phase_a, int analog_input)
+// Timer1 runs in CTC mode with a period of STEP_MICROS. On compare match A the ISR energizes the
+// probe for the next step and selects its analog input. Compare match B, SETTLE_MICROS later,
+// starts the conversion in hardware (ADC auto trigger), and the ADC ISR stores the result and
+// de-energizes the probe again. The probe is only powered for the settle time plus one
+// conversion, and loop() only has to convert the finished buffer halves to resistances.
+void startMeasurement()
 {
-  // read sensor, filter, and calculate resistance value
-  // Noise filter: median filter
+  fillBuffer = 0;
+  fillCycle = 0;
+  step = 0;
+  cyclesLeft = NUM_READS;
+  overruns = 0;
+  bufferReady[0] = bufferReady[1] = false;
+
+  // ADC: AVcc reference, clock / 64 (250kHz at 16MHz, ~54us per conversion),
+  // auto trigger on Timer1 compare match B, conversion complete interrupt
+  ADMUX = bit(REFS0) | steps[0].channel;
+  ADCSRB = bit(ADTS2) | bit(ADTS0);
+  ADCSRA = bit(ADEN) | bit(ADATE) | bit(ADIE) | bit(ADPS2) | bit(ADPS1);
+
+  // Timer1: CTC mode with OCR1A as top, clock / 8 (0.5us per tick at 16MHz)
+  noInterrupts();
+  TCCR1A = 0;
+  TCCR1B = 0;
+  OCR1A = (F_CPU / 8 / 1000000UL) * STEP_MICROS - 1;
+  OCR1B = (F_CPU / 8 / 1000000UL) * SETTLE_MICROS;
+  // Start past compare match B, so the first conversion comes after the first energizing step
+  TCNT1 = OCR1B + 1;
+  TIFR1 = bit(OCF1A) | bit(OCF1B);
+  TIMSK1 = bit(OCIE1A);
+  TCCR1B = bit(WGM12) | bit(CS11);
+  interrupts();
+}
 
-  for (i=0; i<NUM_READS; i++) {
+void stopMeasurement()
+{
+  TCCR1B = 0;
+  TIMSK1 = 0;
+  // Back to the settings analogRead() expects
+  ADCSRA = bit(ADEN) | bit(ADPS2) | bit(ADPS1) | bit(ADPS0);
+  ADCSRB = 0;
+  digitalWrite(6, LOW);
+  digitalWrite(7, LOW);
+}
 
-    // Read 1 pair of voltage values
-    digitalWrite(phase_a, HIGH);                 // set the voltage supply on
-    delayMicroseconds(25);
-    supplyVoltage = analogRead(analog_input);   // read the supply voltage
-    delayMicroseconds(25);
-    digitalWrite(phase_a, LOW);                  // set the voltage supply off
-    delay(1);
+// Start of a step: energize the probe, the conversion starts SETTLE_MICROS later
+ISR(TIMER1_COMPA_vect)
+{
+  if (cyclesLeft == 0) {
+    return;
+  }
+  ADMUX = bit(REFS0) | steps[step].channel;
+  *pinPort[step] |= pinMask[step];
+}
 
-    digitalWrite(phase_b, HIGH);                 // set the voltage supply on
-    delayMicroseconds(25);
-    sensorVoltage = analogRead(analog_input);   // read the sensor voltage
-    delayMicroseconds(25);
-    digitalWrite(phase_b, LOW);                  // set the voltage supply off
+// End of a step: store the sample and power the probe down until the next step
+ISR(ADC_vect)
+{
+  *pinPort[step] &= ~pinMask[step];
+  // The auto trigger fires on the rising edge of OCF1B, which has no ISR to clear it
+  TIFR1 = bit(OCF1B);
+  if (cyclesLeft == 0) {
+    return;
+  }
+  samples[fillBuffer][fillCycle][step] = ADC;
+  if (++step < 4) {
+    return;
+  }
+  step = 0;
+  cyclesLeft--;
+  if (++fillCycle == BUFFER_CYCLES) {
+    if (bufferReady[fillBuffer]) {
+      overruns++;
+    }
+    bufferReady[fillBuffer] = true;
+    fillBuffer ^= 1;
+    fillCycle = 0;
+  }
+}
 
+// Adds the resistances of the read cycles in a full buffer half to the sums and releases it.
+// Returns the number of read cycles in the half.
+int addReadings(uint8_t half, long &sum1, long &sum2)
+{
+  for (uint8_t i = 0; i < BUFFER_CYCLES; i++) {
     // Calculate resistance
-    // the 0.5 add-term is used to round to the nearest integer
     // Tip: no need to transform 0-1023 voltage value to 0-5 range, due to following fraction
-    long resistance = (knownResistor * (supplyVoltage - sensorVoltage ) / sensorVoltage) ;
-
-    delay(1);
-    addReading(resistance);
-    Serial.print (resistance);
-    Serial.print ("\t");
+    sum1 += resistance(samples[half][i][0], samples[half][i][1]);
+    sum2 += resistance(samples[half][i][2], samples[half][i][3]);
   }
+  bufferReady[half] = false;
+  return BUFFER_CYCLES;
 }
 
-
-
-// Averaging algorithm
-void addReading(long resistance){
-  buffer[index] = resistance;
-  index++;
-  if (index >= NUM_READS) index = 0;
-}
-
-long average(){
-  long sum = 0;
-  for (int i = 0; i < NUM_READS; i++){
-    sum += buffer[i];
+long resistance(int supplyVoltage, int sensorVoltage)
+{
+  if (sensorVoltage == 0) {
+    sensorVoltage = 1; // Dry or open probe, avoid dividing by zero
   }
-  return (long)(sum / NUM_READS);
+  return knownResistor * (supplyVoltage - sensorVoltage ) / sensorVoltage;
 }
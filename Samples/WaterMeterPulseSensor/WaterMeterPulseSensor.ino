@@ -25,7 +25,8 @@
  * DESCRIPTION
  * Use this sensor to measure volume and flow of your house watermeter.
  * You need to set the correct pulsefactor of your meter (pulses per m3).
- * The sensor starts by fetching current volume reading from gateway (VAR 1).
+ * The pulse count is checkpointed to EEPROM, so the sensor resumes from the last
+ * checkpoint after a reset. The controller can still set it by sending VAR 1.
  * Reports both volume and flow back to gateway.
  *
  * Unfortunately millis() won't increment when the Arduino is in 
@@ -43,6 +44,7 @@
 
 #include <SPI.h>
 #include <MySensors.h>  
+#include <PulseCounterStore.h>
 
 #define DIGITAL_INPUT_SENSOR 3                  // The digital input you attached your sensor.  (Only 2 and 3 generates interrupt!)
 
@@ -56,16 +58,20 @@
 
 unsigned long SEND_FREQUENCY = 30000;           // Minimum time between send (in milliseconds). We don't want to spam the gateway.
 
+#define CHECKPOINT_SLOTS 8                      // Number of EEPROM slots the checkpoints rotate through
+#define CHECKPOINT_INTERVAL 600000              // Minimum time between pulse count checkpoints (in milliseconds)
+#define CHECKPOINT_CALLS 20                     // ... or number of sends, as millis() stands still in sleep mode
+
 MyMessage flowMsg(CHILD_ID,V_FLOW);
 MyMessage volumeMsg(CHILD_ID,V_VOLUME);
-MyMessage lastCounterMsg(CHILD_ID,V_VAR1);
+
+PulseCounterStore pulseCounterStore(0, CHECKPOINT_SLOTS, CHECKPOINT_INTERVAL, CHECKPOINT_CALLS);
 
 double ppl = ((double)PULSE_FACTOR)/1000;        // Pulses per liter
 
 volatile unsigned long pulseCount = 0;   
 volatile unsigned long lastBlink = 0;
 volatile double flow = 0;  
-boolean pcReceived = false;
 unsigned long oldPulseCount = 0;
 unsigned long newBlink = 0;   
 double oldflow = 0;
@@ -79,10 +85,8 @@ void setup()
   // initialize our digital pins internal pullup resistor so one pulse switches from high to low (less distortion) 
   pinMode(DIGITAL_INPUT_SENSOR, INPUT_PULLUP);
   
-  pulseCount = oldPulseCount = 0;
-
-  // Fetch last known pulse count value from gw
-  request(CHILD_ID, V_VAR1);
+  // Resume from the last checkpointed pulse count
+  pulseCount = oldPulseCount = pulseCounterStore.load();
 
   lastSend = lastPulse = millis();
 
@@ -91,7 +95,7 @@ void setup()
 
 void presentation()  {
   // Send the sketch version information to the gateway and Controller
-  sendSketchInfo("Water Meter", "1.1");
+  sendSketchInfo("Water Meter", "1.2");
 
   // Register this device as Waterflow sensor
   present(CHILD_ID, S_WATER);       
@@ -105,12 +109,6 @@ void loop()
   if (SLEEP_MODE || (currentTime - lastSend > SEND_FREQUENCY))
   {
     lastSend=currentTime;
-    
-    if (!pcReceived) {
-      //Last Pulsecount not yet received from controller, request it again
-      request(CHILD_ID, V_VAR1);
-      return;
-    }
 
     if (!SLEEP_MODE && flow != oldflow) {
       oldflow = flow;
@@ -137,7 +135,7 @@ void loop()
       Serial.print("pulsecount:");
       Serial.println(pulseCount);
 
-      send(lastCounterMsg.set(pulseCount));                  // Send  pulsecount value to gw in VAR1
+      pulseCounterStore.checkpoint(oldPulseCount);            // Checkpoint pulsecount to EEPROM
 
       double volume = ((double)pulseCount/((double)PULSE_FACTOR));     
       if ((volume != oldvolume)||(!SLEEP_MODE)) {
@@ -157,12 +155,15 @@ void loop()
 
 void receive(const MyMessage &message) {
   if (message.type==V_VAR1) {
+    // The controller overrides the stored pulse count
     unsigned long gwPulseCount=message.getULong();
-    pulseCount += gwPulseCount;
+    noInterrupts();
+    pulseCount = gwPulseCount;
+    interrupts();
+    pulseCounterStore.reset(gwPulseCount);
     flow=oldflow=0;
-    Serial.print("Received last pulse count from gw:");
-    Serial.println(pulseCount);
-    pcReceived = true;
+    Serial.print("Received pulse count from gw:");
+    Serial.println(gwPulseCount);
   }
 }
 
@@ -100,6 +100,7 @@
 #define USER_SOFT_SERIAL
 #define STORE_AES_KEY
 #define USER_AES_KEY
+#define MACHINE_READABLE_DUMP
 #endif
 
 /**
@@ -185,10 +186,28 @@
  */
 //#define USER_AES_KEY
 
+/**
+ * @def MACHINE_READABLE_DUMP
+ * @brief Uncomment this to only dump the security state as CSV records and skip personalization
+ *
+ * Nothing is written to EEPROM or ATSHA204A in this mode. Each record is a line of the form
+ * <tt>KEY,VALUE</tt>. The dump starts with <tt>MYSDUMP,1</tt> and ends with <tt>END,CRC</tt>.
+ * CRC is the CRC-16/CCITT-FALSE over every byte before the END record, as 4 hex digits.
+ * Keys are never dumped. Only the first 8 bytes of their SHA256 are printed, so nodes can
+ * be compared without exposing the keys. Use audit.py next to this sketch to collect and
+ * check the dumps of many nodes.
+ */
+//#define MACHINE_READABLE_DUMP
+
 #if defined(SKIP_UART_CONFIRMATION) && !defined(USER_KEY)
 #error You have to define USER_KEY for boards that does not have UART
 #endif
 
+#if defined(MACHINE_READABLE_DUMP) && (defined(LOCK_CONFIGURATION) || defined(LOCK_DATA) || \
+    defined(STORE_SOFT_KEY) || defined(STORE_SOFT_SERIAL) || defined(STORE_AES_KEY))
+#error MACHINE_READABLE_DUMP only reads the security state, disable all LOCK_ and STORE_ flags
+#endif
+
 #ifdef USER_KEY
 /** @brief The user-defined HMAC key to use for personalization */
 #define MY_HMAC_KEY 0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00,0x00
@@ -857,6 +876,222 @@ void dump_configuration()
 #endif // not USE_SOFT_SIGNING
 }
 
+#ifdef MACHINE_READABLE_DUMP
+uint16_t dump_crc; //!< Running CRC-16/CCITT-FALSE of the machine readable dump
+
+/** @brief Print a character of the machine readable dump and add it to the dump CRC */
+void dump_char(char c)
+{
+  Serial.print(c);
+  dump_crc ^= (uint16_t)(uint8_t)c << 8;
+  for (int i=0; i<8; i++)
+  {
+    dump_crc = (dump_crc & 0x8000) ? (dump_crc << 1) ^ 0x1021 : dump_crc << 1;
+  }
+}
+
+/** @brief Print a flash string of the machine readable dump */
+void dump_text(const __FlashStringHelper* text)
+{
+  PGM_P p = reinterpret_cast<PGM_P>(text);
+  char c;
+  while ((c = pgm_read_byte(p++)) != 0)
+  {
+    dump_char(c);
+  }
+}
+
+/** @brief Print a buffer as hex digits in the machine readable dump */
+void dump_hex(const uint8_t* buffer, uint8_t length)
+{
+  for (int i=0; i<length; i++)
+  {
+    dump_char("0123456789ABCDEF"[buffer[i] >> 4]);
+    dump_char("0123456789ABCDEF"[buffer[i] & 0x0F]);
+  }
+}
+
+/** @brief Start a record of the machine readable dump */
+void dump_record(const __FlashStringHelper* key)
+{
+  dump_text(key);
+  dump_char(',');
+}
+
+/** @brief End a record of the machine readable dump */
+void dump_end_record()
+{
+  dump_char('\r');
+  dump_char('\n');
+}
+
+/** @brief Dump a record with a single value given as a flash string */
+void dump_text_record(const __FlashStringHelper* key, const __FlashStringHelper* value)
+{
+  dump_record(key);
+  dump_text(value);
+  dump_end_record();
+}
+
+/** @brief Dump a record with a buffer as hex value */
+void dump_hex_record(const __FlashStringHelper* key, const uint8_t* buffer, uint8_t length)
+{
+  dump_record(key);
+  dump_hex(buffer, length);
+  dump_end_record();
+}
+
+/** @brief Dump a record with the first 8 bytes of the SHA256 of an EEPROM block */
+void dump_eeprom_hash_record(const __FlashStringHelper* key, void* address, uint8_t length)
+{
+  uint8_t buffer[32];
+  hwReadConfigBlock((void*)buffer, address, length);
+  signerSha256Init();
+  signerSha256Update(buffer, length);
+  memset(buffer, 0, sizeof(buffer));
+  dump_hex_record(key, signerSha256Final(), 8);
+}
+
+#ifndef USE_SOFT_SIGNING
+/** @brief Dump a failed ATSHA204A operation */
+void dump_atsha204a_error(const __FlashStringHelper* operation, uint8_t ret_code)
+{
+  dump_record(F("ERROR"));
+  dump_text(operation);
+  dump_char(',');
+  dump_hex(&ret_code, 1);
+  dump_end_record();
+}
+
+/**
+ * @brief Dump serial, revision, lock state and configuration zone of the ATSHA204A
+ * @param[out] serial The ATSHA204A serial, all 0xFF if it could not be read
+ */
+void dump_atsha204a(uint8_t* serial)
+{
+  uint8_t tx_buffer[SHA204_CMD_SIZE_MAX];
+  uint8_t rx_buffer[SHA204_RSP_SIZE_MAX];
+  uint8_t config[88];
+  uint8_t ret_code;
+
+  memset(serial, 0xFF, 9);
+  ret_code = sha204.sha204c_wakeup(rx_buffer);
+  if (ret_code != SHA204_SUCCESS)
+  {
+    dump_atsha204a_error(F("WAKEUP"), ret_code);
+    return;
+  }
+  ret_code = sha204.getSerialNumber(rx_buffer);
+  if (ret_code != SHA204_SUCCESS)
+  {
+    dump_atsha204a_error(F("SERIAL"), ret_code);
+    return;
+  }
+  memcpy(serial, rx_buffer, 9);
+  dump_hex_record(F("ATSHA204A_SERIAL"), serial, 9);
+
+  ret_code = sha204.sha204m_dev_rev(tx_buffer, rx_buffer);
+  if (ret_code != SHA204_SUCCESS)
+  {
+    dump_atsha204a_error(F("REVISION"), ret_code);
+    return;
+  }
+  dump_hex_record(F("ATSHA204A_REVISION"), &rx_buffer[SHA204_BUFFER_POS_DATA], 4);
+
+  for (int i=0; i < 88; i += 4)
+  {
+    ret_code = sha204.sha204m_read(tx_buffer, rx_buffer, SHA204_ZONE_CONFIG, i);
+    if (ret_code != SHA204_SUCCESS)
+    {
+      dump_atsha204a_error(F("CONFIG"), ret_code);
+      return;
+    }
+    memcpy(&config[i], &rx_buffer[SHA204_BUFFER_POS_DATA], 4);
+  }
+  // LockValue and LockConfig are the last two bytes of the configuration zone
+  dump_text_record(F("ATSHA204A_CONFIG_LOCK"), config[87] == 0x00 ? F("LOCKED") : F("UNLOCKED"));
+  dump_text_record(F("ATSHA204A_DATA_LOCK"), config[86] == 0x00 ? F("LOCKED") : F("UNLOCKED"));
+  dump_hex_record(F("ATSHA204A_CONFIG"), config, 88);
+}
+#endif // not USE_SOFT_SIGNING
+
+/** @brief Dump the security state of the node as CSV records, see @ref MACHINE_READABLE_DUMP */
+void dump_machine_readable()
+{
+  uint8_t buffer[32];
+  uint8_t checksum;
+  unique_id_t uniqueID;
+  bool has_unique_id = hwUniqueID(&uniqueID);
+
+  dump_crc = 0xFFFF;
+  dump_text_record(F("MYSDUMP"), F("1"));
+#ifdef USE_SOFT_SIGNING
+  dump_text_record(F("BACKEND"), F("SOFT"));
+#else
+  dump_text_record(F("BACKEND"), F("ATSHA204A"));
+  uint8_t atsha204a_serial[9];
+  dump_atsha204a(atsha204a_serial);
+#endif
+
+  if (has_unique_id)
+  {
+    dump_hex_record(F("UNIQUE_ID"), uniqueID, sizeof(uniqueID));
+  }
+  else
+  {
+    dump_text_record(F("UNIQUE_ID"), F("NONE"));
+  }
+  hwReadConfigBlock((void*)buffer, (void*)EEPROM_SIGNING_SOFT_SERIAL_ADDRESS, 9);
+  dump_hex_record(F("SOFT_SERIAL"), buffer, 9);
+
+  // The serial the node signs with, which is what a gateway whitelist has to list for it
+#ifdef USE_SOFT_SIGNING
+  bool serial_erased = true;
+  for (int i=0; i<9; i++)
+  {
+    serial_erased = serial_erased && buffer[i] == 0xFF;
+  }
+  if (serial_erased && has_unique_id)
+  {
+    memcpy(buffer, uniqueID, 9);
+  }
+  dump_hex_record(F("WHITELIST_SERIAL"), buffer, 9);
+#else
+  dump_hex_record(F("WHITELIST_SERIAL"), atsha204a_serial, 9);
+#endif
+
+  dump_eeprom_hash_record(F("SOFT_HMAC_KEY_SHA256"), (void*)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS, 32);
+  dump_eeprom_hash_record(F("AES_KEY_SHA256"), (void*)EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS, 16);
+
+  // Same checksum as the personalizer stores: first byte of the SHA256 over HMAC key, AES key and serial
+  signerSha256Init();
+  hwReadConfigBlock((void*)buffer, (void*)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS, 32);
+  signerSha256Update(buffer, 32);
+  hwReadConfigBlock((void*)buffer, (void*)EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS, 16);
+  signerSha256Update(buffer, 16);
+  hwReadConfigBlock((void*)buffer, (void*)EEPROM_SIGNING_SOFT_SERIAL_ADDRESS, 9);
+  signerSha256Update(buffer, 9);
+  memset(buffer, 0, sizeof(buffer));
+  checksum = signerSha256Final()[0];
+  hwReadConfigBlock((void*)buffer, (void*)EEPROM_PERSONALIZATION_CHECKSUM_ADDRESS, 1);
+  dump_hex_record(F("EEPROM_CHECKSUM"), buffer, 1);
+  dump_text_record(F("EEPROM_CHECKSUM_VALID"), buffer[0] == checksum ? F("YES") : F("NO"));
+
+  // The CRC covers everything up to here, so it is printed without going through dump_char
+  uint8_t crc[2] = {(uint8_t)(dump_crc >> 8), (uint8_t)dump_crc};
+  Serial.print(F("END,"));
+  for (int i=0; i<2; i++)
+  {
+    if (crc[i] < 0x10)
+    {
+      Serial.print('0'); // Because Serial.print does not 0-pad HEX
+    }
+    Serial.print(crc[i], HEX);
+  }
+  Serial.println();
+}
+#endif // MACHINE_READABLE_DUMP
+
 /** @brief Sketch setup code */
 void setup()
 {
@@ -880,6 +1115,11 @@ void setup()
 
   Serial.begin(115200);
 
+#ifdef MACHINE_READABLE_DUMP
+  dump_machine_readable();
+  return;
+#endif
+
   Serial.println(F("Personalization sketch for MySensors usage."));
   Serial.println(F("-------------------------------------------"));
 
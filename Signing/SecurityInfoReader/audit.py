@@ -0,0 +1,178 @@
+#!/usr/bin/env python3
+"""Fleet audit for SecurityInfoReader.ino built with MACHINE_READABLE_DUMP.
+
+Collects the dumps of any number of nodes, either live from serial ports or from captured
+serial logs, checks each one and writes one CSV row per node. A log may hold the dumps of
+several nodes one after the other; anything outside a MYSDUMP ... END block is ignored.
+
+Pyserial (pip install pyserial) is only needed for --port.
+
+  python3 audit.py --port /dev/ttyUSB0 --port /dev/ttyUSB1 --output audit.csv
+  python3 audit.py node1.log node2.log --hmac-key-sha256 0123456789ABCDEF
+"""
+
+import argparse
+import csv
+import hashlib
+import sys
+
+BAUD_RATE = 115200
+DUMP_TIMEOUT = 10
+FORMAT_VERSION = "1"
+
+COLUMNS = [
+    "source", "BACKEND", "WHITELIST_SERIAL", "ATSHA204A_SERIAL", "ATSHA204A_REVISION",
+    "ATSHA204A_CONFIG_LOCK", "ATSHA204A_DATA_LOCK", "UNIQUE_ID", "SOFT_SERIAL",
+    "SOFT_HMAC_KEY_SHA256", "AES_KEY_SHA256", "EEPROM_CHECKSUM", "EEPROM_CHECKSUM_VALID",
+    "ATSHA204A_CONFIG", "problems",
+]
+
+# Key hashes of erased EEPROM, as printed by the sketch
+ERASED_HMAC_KEY = hashlib.sha256(b"\xff" * 32).hexdigest()[:16].upper()
+ERASED_AES_KEY = hashlib.sha256(b"\xff" * 16).hexdigest()[:16].upper()
+ERASED_SERIAL = "FF" * 9
+
+
+class DumpError(Exception):
+    pass
+
+
+def crc16(data, crc=0xFFFF):
+    # CRC-16/CCITT-FALSE, same as dump_char() in the sketch
+    for byte in data:
+        crc ^= byte << 8
+        for _ in range(8):
+            crc = ((crc << 1) ^ 0x1021 if crc & 0x8000 else crc << 1) & 0xFFFF
+    return crc
+
+
+def check_end(text, crc, records):
+    try:
+        if int(text[4:], 16) != crc:
+            raise DumpError("dump CRC mismatch")
+    except ValueError:
+        raise DumpError("malformed END record %r" % text)
+    if records.get("MYSDUMP") != FORMAT_VERSION:
+        raise DumpError("unsupported dump version %s" % records.get("MYSDUMP"))
+
+
+def parse_dumps(lines):
+    """Yields a record dict per dump in an iterable of raw byte lines.
+
+    A dump that fails its checks yields a DumpError instead, so the dumps around it are
+    still read.
+    """
+    records = None
+    for number, line in enumerate(lines, 1):
+        if line.startswith(b"MYSDUMP,"):
+            records, crc, start = {}, 0xFFFF, number
+        if records is None:
+            continue
+        text = line.decode("ascii", "replace").strip()
+        if text.startswith("END,"):
+            try:
+                check_end(text, crc, records)
+            except DumpError as error:
+                yield DumpError("line %d: %s" % (start, error))
+            else:
+                yield records
+            records = None
+            continue
+        # The sketch ends every record with CR LF, which is part of the CRC
+        crc = crc16(line.rstrip(b"\r\n") + b"\r\n", crc)
+        key, _, value = text.partition(",")
+        if key == "ERROR":
+            records.setdefault("ERROR", []).append(value)
+        else:
+            records[key] = value
+    if records is not None:
+        yield DumpError("line %d: incomplete dump" % start)
+
+
+def check(records, args):
+    problems = ["ATSHA204A %s failed (%s)" % tuple(error.split(",")) for error in records.get("ERROR", [])]
+    if records.get("BACKEND") == "ATSHA204A":
+        for zone in ("CONFIG", "DATA"):
+            if records.get("ATSHA204A_%s_LOCK" % zone) == "UNLOCKED":
+                problems.append("ATSHA204A %s zone unlocked" % zone.lower())
+    else:
+        if records.get("SOFT_HMAC_KEY_SHA256") == ERASED_HMAC_KEY:
+            problems.append("no soft HMAC key")
+        if records.get("WHITELIST_SERIAL") == ERASED_SERIAL:
+            problems.append("no soft serial")
+    if records.get("AES_KEY_SHA256") == ERASED_AES_KEY:
+        problems.append("no AES key")
+    if records.get("EEPROM_CHECKSUM_VALID") == "NO":
+        problems.append("EEPROM checksum mismatch")
+    if args.hmac_key_sha256 and records.get("BACKEND") == "SOFT" and \
+            records.get("SOFT_HMAC_KEY_SHA256") != args.hmac_key_sha256.upper():
+        problems.append("unexpected soft HMAC key")
+    if args.aes_key_sha256 and records.get("AES_KEY_SHA256") != args.aes_key_sha256.upper():
+        problems.append("unexpected AES key")
+    return problems
+
+
+def read_port(port):
+    import serial
+    # Opening the port resets most boards, which starts a new dump
+    with serial.Serial(port, BAUD_RATE, timeout=DUMP_TIMEOUT) as connection:
+        for records in parse_dumps(iter(connection.readline, b"")):
+            return [records]
+    raise DumpError("no dump received")
+
+
+def read_file(path):
+    with open(path, "rb") as log:
+        return list(parse_dumps(log))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("logs", nargs="*", help="captured serial logs to read dumps from")
+    parser.add_argument("--port", action="append", default=[], help="serial port of a node, may be repeated")
+    parser.add_argument("--output", help="CSV file to write, default is stdout")
+    parser.add_argument("--hmac-key-sha256", help="expected SOFT_HMAC_KEY_SHA256 of every soft signing node")
+    parser.add_argument("--aes-key-sha256", help="expected AES_KEY_SHA256 of every node")
+    args = parser.parse_args()
+    if not args.logs and not args.port:
+        parser.error("give at least one log file or --port")
+
+    rows = []
+    sources = [(port, read_port) for port in args.port] + [(path, read_file) for path in args.logs]
+    for source, read in sources:
+        try:
+            dumps = read(source)
+        except (DumpError, OSError) as error:
+            rows.append({"source": source, "problems": str(error)})
+            continue
+        for records in dumps:
+            if isinstance(records, DumpError):
+                rows.append({"source": source, "problems": str(records)})
+                continue
+            row = {column: records.get(column, "") for column in COLUMNS}
+            row["source"] = source
+            row["problems"] = "; ".join(check(records, args))
+            rows.append(row)
+
+    # A whitelist entry only identifies a node if no other node has the same serial
+    serials = [row.get("WHITELIST_SERIAL") for row in rows if row.get("WHITELIST_SERIAL")]
+    for row in rows:
+        if row.get("WHITELIST_SERIAL") and serials.count(row["WHITELIST_SERIAL"]) > 1:
+            row["problems"] = "; ".join(filter(None, [row["problems"], "duplicate whitelist serial"]))
+
+    output = open(args.output, "w", newline="") if args.output else sys.stdout
+    try:
+        writer = csv.DictWriter(output, COLUMNS, restval="")
+        writer.writeheader()
+        writer.writerows(rows)
+    finally:
+        if args.output:
+            output.close()
+
+    failed = sum(1 for row in rows if row["problems"])
+    print("%d node(s) audited, %d with problems" % (len(rows), failed), file=sys.stderr)
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -57,6 +57,28 @@
  * can be done by replacing PERSONALIZE_SOFT in step 2 above with 
  * PERSONALIZE_SOFT_RANDOM_SERIAL. See the output under "Hardware security peripherals" 
  * to determine if this is necessary.
+ *
+ * To provision many devices, enable BATCH_PROVISIONING (optionally with USE_SOFT_SIGNING)
+ * and let provision.py drive the sketch. The sketch prints READY and then answers one
+ * command per line with a line starting with OK or ERR:
+ *
+ *   INFO                     OK ATSHA204A <serial> LOCKED|UNLOCKED, or
+ *                            OK SOFT <serial> UNIQUE_ID|NO_UNIQUE_ID
+ *                            (wakes the device; send it first for every device)
+ *   LOCK                     OK (writes and locks the ATSHA204A configuration if unlocked)
+ *   GEN HMAC|AES|SERIAL      OK <random hex data>
+ *   SET HMAC|AES|SERIAL <hex>  OK (stores the key or soft serial)
+ *   CHECKSUM                 OK <checksum> (writes the EEPROM personalization checksum)
+ *   DUMP                     OK <HMAC key> <AES key> <soft serial> <checksum> (from EEPROM)
+ *   MAC <challenge>          OK <response> (ATSHA204A MAC of the 32 byte hex challenge with
+ *                            the key in slot 0, so the host can check the key it stored)
+ *
+ * Failures are reported as ERR <reason> [<last ATSHA204A return code>]. SERIAL is only
+ * available with USE_SOFT_SIGNING. With an ATSHA204A in a socket, one personalizer can
+ * provision chips back to back; send INFO after each swap. SET AES, CHECKSUM and DUMP work
+ * on the personalizer's own EEPROM, so in that setup provision.py only locks the chip,
+ * stores the HMAC key and checks it by MAC. The AES key of a node with an ATSHA204A is
+ * stored by running this sketch on the node itself.
 
  * When you have personalized your first device after step 2 above, you can run the 
  * same sketch on all devices in your network that needs to be personalized in a 
@@ -95,6 +117,7 @@
 //#define STORE_SOFT_SERIAL
 //#define PRINT_DETAILED_ATSHA204A_CONFIG
 //#define RESET_EEPROM_PERSONALIZATION
+//#define BATCH_PROVISIONING
 /********************* Guided mode flag configurations (don't change these) ***********************/
 #ifdef GENERATE_KEYS_ATSHA204A
 #define LOCK_ATSHA204A_CONFIGURATION // We have to lock configuration to enable random number generation
@@ -125,6 +148,19 @@
 #define STORE_SOFT_SERIAL // Store the soft serial number
 #define SKIP_UART_CONFIRMATION // This is an automated mode
 #endif
+#ifdef BATCH_PROVISIONING
+#define GENERATE_HMAC_KEY // The host can ask for random keys
+#define GENERATE_AES_KEY
+#define STORE_HMAC_KEY // The host supplies the keys to store
+#define STORE_AES_KEY
+#ifdef USE_SOFT_SIGNING
+#define GENERATE_SOFT_SERIAL
+#define STORE_SOFT_SERIAL
+#else
+#define LOCK_ATSHA204A_CONFIGURATION // The host decides when to lock
+#endif
+#define SKIP_UART_CONFIRMATION // This is an automated mode
+#endif
 #if defined(GENERATE_HMAC_KEY) || defined(GENERATE_AES_KEY) || defined(GENERATE_SOFT_SERIAL)
 #define GENERATE_SOMETHING
 #endif
@@ -218,6 +254,18 @@
 #error You cannot reset EEPROM personalization when personalizing a device
 #endif
 #endif // PERSONALIZE_SOFT_RANDOM_SERIAL
+#ifdef BATCH_PROVISIONING
+#if defined(GENERATE_KEYS_ATSHA204A) ||\
+        defined (GENERATE_KEYS_SOFT) ||\
+        defined (PERSONALIZE_ATSHA204A) ||\
+        defined (PERSONALIZE_SOFT) ||\
+        defined (PERSONALIZE_SOFT_RANDOM_SERIAL)
+#error You can not enable BATCH_PROVISIONING together with the guided modes
+#endif
+#ifdef RESET_EEPROM_PERSONALIZATION
+#error You cannot reset EEPROM personalization in batch provisioning mode
+#endif
+#endif // BATCH_PROVISIONING
 #if !defined(GENERATE_KEYS_ATSHA204A) &&\
         !defined(GENERATE_KEYS_SOFT) &&\
         !defined(PERSONALIZE_ATSHA204A) &&\
@@ -263,20 +311,26 @@ static bool store_soft_serial_data(uint8_t* data, size_t sz);
 #endif
 #ifndef USE_SOFT_SIGNING
 static void init_atsha204a_state(void);
+static bool read_atsha204a_lock_state(void);
 #ifdef LOCK_ATSHA204A_CONFIGURATION
 static void lock_atsha204a_config(void);
-static uint16_t write_atsha204a_config_and_get_crc(void);
+static bool lock_atsha204a_config_zone(uint16_t crc);
+static bool write_atsha204a_config_and_get_crc(uint16_t* crc);
 #endif
 static bool get_atsha204a_serial(uint8_t* data);
 #ifdef STORE_HMAC_KEY
 static bool write_atsha204a_key(uint8_t* key);
 #endif
+#ifdef BATCH_PROVISIONING
+static bool get_atsha204a_mac(uint8_t* challenge, uint8_t* mac);
+#endif
 #endif // not USE_SOFT_SIGNING
 static void print_greeting(void);
 static void print_ending(void);
 static void probe_and_print_peripherals(void);
 static void print_eeprom_data(void);
 static void print_whitelisting_entry(void);
+static void get_whitelisting_serial(uint8_t* data);
 #ifdef PRINT_DETAILED_ATSHA204A_CONFIG
 static void dump_detailed_atsha204a_configuration(void);
 #endif
@@ -284,6 +338,12 @@ static void dump_detailed_atsha204a_configuration(void);
 static void reset_eeprom(void);
 #endif
 static void write_eeprom_checksum(void);
+#ifdef BATCH_PROVISIONING
+static void process_provisioning_input(void);
+static void run_provisioning_command(char* command);
+static bool parse_hex_buffer(const char* hex, uint8_t* data, size_t sz);
+static void reply_provisioning_error(const __FlashStringHelper* reason);
+#endif
 /**************************************** File local data *****************************************/
 #if defined(GENERATE_HMAC_KEY) || defined(STORE_HMAC_KEY)
 static uint8_t user_hmac_key[32] = {MY_HMAC_KEY};
@@ -305,6 +365,10 @@ static uint8_t lockConfig = 0;
 static uint8_t lockValue = 0;
 #endif
 static bool has_device_unique_id = false;
+#ifdef BATCH_PROVISIONING
+static char provisioning_line[80];
+static uint8_t provisioning_line_length = 0;
+#endif
 static const uint8_t reset_buffer[32] = {
     0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
     0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF,
@@ -322,6 +386,11 @@ void setup()
     hwRandomNumberInit();
 #endif
     while(!Serial); // For USB enabled devices, wait for USB enumeration before continuing
+#ifdef BATCH_PROVISIONING
+    // The host takes it from here, see process_provisioning_input()
+    Serial.println(F("READY"));
+    return;
+#endif
     print_greeting();
 #ifndef USE_SOFT_SIGNING
     init_atsha204a_state();
@@ -349,6 +418,9 @@ void setup()
 }
 void loop()
 {
+#ifdef BATCH_PROVISIONING
+    process_provisioning_input();
+#endif
 }
 static void halt(bool success)
 {
@@ -647,7 +719,7 @@ static bool store_hmac_key_data(uint8_t* data)
     }
 #else
     // It will not be possible to write the key if the configuration zone is unlocked
-    if (lockConfig == 0x00) {
+    if (read_atsha204a_lock_state() && lockConfig == 0x00) {
         // Write the key to the appropriate slot in the data zone
         if (!write_atsha204a_key(data)) {
             return false;
@@ -690,14 +762,21 @@ static bool store_soft_serial_data(uint8_t* data)
 #endif // STORE_SOFT_SERIAL
 #ifndef USE_SOFT_SIGNING
 static void init_atsha204a_state(void)
+{
+    if (!read_atsha204a_lock_state()) {
+        halt(false);
+    }
+}
+static bool read_atsha204a_lock_state(void)
 {
     // Read out lock config bits to determine if locking is possible
     ret_code = sha204.sha204m_read(tx_buffer, rx_buffer, SHA204_ZONE_CONFIG, 0x15<<2);
     if (ret_code != SHA204_SUCCESS) {
-        halt(false);
+        return false;
     } else {
         lockConfig = rx_buffer[SHA204_BUFFER_POS_DATA+3];
         lockValue = rx_buffer[SHA204_BUFFER_POS_DATA+2];
+        return true;
     }
 }
 #ifdef LOCK_ATSHA204A_CONFIGURATION
@@ -713,7 +792,11 @@ static void lock_atsha204a_config(void)
         uint16_t crc;
         (void)crc;
         // Write config and get CRC for the updated config
-        crc = write_atsha204a_config_and_get_crc();
+        if (!write_atsha204a_config_and_get_crc(&crc)) {
+            Serial.println(
+                F("+------------------------------------------------------------------------------------+"));
+            halt(false);
+        }
         // List current configuration before attempting to lock
 #ifdef PRINT_DETAILED_ATSHA204A_CONFIG
         Serial.println(
@@ -732,34 +815,13 @@ static void lock_atsha204a_config(void)
 #endif //not SKIP_UART_CONFIRMATION
         {
             Serial.print(F("| * Locking configuration..."));
-            // Correct sequence, resync chip
-            ret_code = sha204.sha204c_resync(SHA204_RSP_SIZE_MAX, rx_buffer);
-            if (ret_code != SHA204_SUCCESS && ret_code != SHA204_RESYNC_WITH_WAKEUP) {
-                Serial.println(
-                    F("+------------------------------------------------------------------------------------+"));
-                halt(false);
-            }
-            // Lock configuration zone
-            ret_code = sha204.sha204m_execute(SHA204_LOCK, SHA204_ZONE_CONFIG,
-                                              crc, 0, NULL, 0, NULL, 0, NULL,
-                                              LOCK_COUNT, tx_buffer, LOCK_RSP_SIZE, rx_buffer);
-            if (ret_code != SHA204_SUCCESS) {
+            if (!lock_atsha204a_config_zone(crc)) {
                 Serial.println(F("Failed                                                   |"));
                 Serial.println(
                     F("+------------------------------------------------------------------------------------+"));
                 halt(false);
             } else {
                 Serial.println(F("Done                                                     |"));
-                // Update lock flags after locking
-                ret_code = sha204.sha204m_read(tx_buffer, rx_buffer, SHA204_ZONE_CONFIG, 0x15<<2);
-                if (ret_code != SHA204_SUCCESS) {
-                    Serial.println(
-                        F("+------------------------------------------------------------------------------------+"));
-                    halt(false);
-                } else {
-                    lockConfig = rx_buffer[SHA204_BUFFER_POS_DATA+3];
-                    lockValue = rx_buffer[SHA204_BUFFER_POS_DATA+2];
-                }
             }
         }
 #ifndef SKIP_UART_CONFIRMATION
@@ -778,96 +840,84 @@ static void lock_atsha204a_config(void)
     }
     Serial.println();
 }
-static uint16_t write_atsha204a_config_and_get_crc(void)
+static bool lock_atsha204a_config_zone(uint16_t crc)
+{
+    // Correct sequence, resync chip
+    ret_code = sha204.sha204c_resync(SHA204_RSP_SIZE_MAX, rx_buffer);
+    if (ret_code != SHA204_SUCCESS && ret_code != SHA204_RESYNC_WITH_WAKEUP) {
+        return false;
+    }
+    // Lock configuration zone
+    ret_code = sha204.sha204m_execute(SHA204_LOCK, SHA204_ZONE_CONFIG,
+                                      crc, 0, NULL, 0, NULL, 0, NULL,
+                                      LOCK_COUNT, tx_buffer, LOCK_RSP_SIZE, rx_buffer);
+    if (ret_code != SHA204_SUCCESS) {
+        return false;
+    }
+    // Update lock flags after locking
+    return read_atsha204a_lock_state();
+}
+static bool write_atsha204a_config_and_get_crc(uint16_t* crc)
 {
-    uint16_t crc = 0;
-    uint8_t config_word[4];
     // We will set default settings from datasheet on all slots. This means that we can use slot 0 for the key
     // as that slot will not be readable (key will therefore be secure) and slot 8 for the payload digest
     // calculationon as that slot can be written in clear text even when the datazone is locked.
     // Other settings which are not relevant are kept as is.
-    for (int i=0; i < 88; i += 4) {
-        bool do_write = true;
-        if (i == 20) {
-            config_word[0] = 0x8F;
-            config_word[1] = 0x80;
-            config_word[2] = 0x80;
-            config_word[3] = 0xA1;
-        } else if (i == 24) {
-            config_word[0] = 0x82;
-            config_word[1] = 0xE0;
-            config_word[2] = 0xA3;
-            config_word[3] = 0x60;
-        } else if (i == 28) {
-            config_word[0] = 0x94;
-            config_word[1] = 0x40;
-            config_word[2] = 0xA0;
-            config_word[3] = 0x85;
-        } else if (i == 32) {
-            config_word[0] = 0x86;
-            config_word[1] = 0x40;
-            config_word[2] = 0x87;
-            config_word[3] = 0x07;
-        } else if (i == 36) {
-            config_word[0] = 0x0F;
-            config_word[1] = 0x00;
-            config_word[2] = 0x89;
-            config_word[3] = 0xF2;
-        } else if (i == 40) {
-            config_word[0] = 0x8A;
-            config_word[1] = 0x7A;
-            config_word[2] = 0x0B;
-            config_word[3] = 0x8B;
-        } else if (i == 44) {
-            config_word[0] = 0x0C;
-            config_word[1] = 0x4C;
-            config_word[2] = 0xDD;
-            config_word[3] = 0x4D;
-        } else if (i == 48) {
-            config_word[0] = 0xC2;
-            config_word[1] = 0x42;
-            config_word[2] = 0xAF;
-            config_word[3] = 0x8F;
-        } else if (i == 52 || i == 56 || i == 60 || i == 64) {
-            config_word[0] = 0xFF;
-            config_word[1] = 0x00;
-            config_word[2] = 0xFF;
-            config_word[3] = 0x00;
-        } else if (i == 68 || i == 72 || i == 76 || i == 80) {
-            config_word[0] = 0xFF;
-            config_word[1] = 0xFF;
-            config_word[2] = 0xFF;
-            config_word[3] = 0xFF;
+    static const uint8_t slot_config[32] PROGMEM = {
+        0x8F, 0x80, 0x80, 0xA1, 0x82, 0xE0, 0xA3, 0x60, 0x94, 0x40, 0xA0, 0x85, 0x86, 0x40, 0x87, 0x07,
+        0x0F, 0x00, 0x89, 0xF2, 0x8A, 0x7A, 0x0B, 0x8B, 0x0C, 0x4C, 0xDD, 0x4D, 0xC2, 0x42, 0xAF, 0x8F
+    };
+    uint8_t config[88];
+    uint32_t changed_words = 0;
+    // Read the current configuration, blocks 0 and 1 with one 32 byte read each
+    for (int i=0; i < 88; i += (i < 64 ? 32 : 4)) {
+        ret_code = sha204.sha204m_read(tx_buffer, rx_buffer,
+                                       i < 64 ? SHA204_ZONE_CONFIG | SHA204_ZONE_COUNT_FLAG : SHA204_ZONE_CONFIG, i);
+        if (ret_code != SHA204_SUCCESS) {
+            return false;
+        }
+        memcpy(&config[i], &rx_buffer[SHA204_BUFFER_POS_DATA], i < 64 ? 32 : 4);
+    }
+    // Apply the settings to bytes 20 to 83 (SlotConfig, UseFlag/UpdateCount and LastKeyUse)
+    // and remember which words differ from what the device holds
+    for (int i=20; i < 84; i++) {
+        uint8_t value;
+        if (i < 52) {
+            value = pgm_read_byte(&slot_config[i-20]);
+        } else if (i < 68) {
+            value = (i % 2 == 0) ? 0xFF : 0x00;
         } else {
-            // All other configs are untouched
-            ret_code = sha204.sha204m_read(tx_buffer, rx_buffer, SHA204_ZONE_CONFIG, i);
-            if (ret_code != SHA204_SUCCESS) {
-                Serial.println(
-                    F("+------------------------------------------------------------------------------------+"));
-                halt(false);
-            }
-            // Set config_word to the read data
-            config_word[0] = rx_buffer[SHA204_BUFFER_POS_DATA+0];
-            config_word[1] = rx_buffer[SHA204_BUFFER_POS_DATA+1];
-            config_word[2] = rx_buffer[SHA204_BUFFER_POS_DATA+2];
-            config_word[3] = rx_buffer[SHA204_BUFFER_POS_DATA+3];
-            do_write = false;
+            value = 0xFF;
         }
-        // Update crc with CRC for the current word
-        crc = sha204.calculateAndUpdateCrc(4, config_word, crc);
-        // Write config word
-        if (do_write) {
-            ret_code = sha204.sha204m_execute(SHA204_WRITE, SHA204_ZONE_CONFIG,
-                                              i >> 2, 4, config_word, 0, NULL, 0, NULL,
-                                              WRITE_COUNT_SHORT, tx_buffer, WRITE_RSP_SIZE, rx_buffer);
-            if (ret_code != SHA204_SUCCESS) {
-                Serial.println(
-                    F("+------------------------------------------------------------------------------------+"));
-                halt(false);
-            }
+        if (config[i] != value) {
+            config[i] = value;
+            changed_words |= (uint32_t)1 << (i >> 2);
+        }
+    }
+    *crc = sha204.calculateAndUpdateCrc(88, config, 0);
+    // Block 1 (bytes 32 to 63) lies entirely within the settings, so it can be written in one go
+    if (changed_words & ((uint32_t)0xFF << 8)) {
+        ret_code = sha204.sha204m_execute(SHA204_WRITE, SHA204_ZONE_CONFIG | SHA204_ZONE_COUNT_FLAG,
+                                          32 >> 2, SHA204_ZONE_ACCESS_32, &config[32], 0, NULL, 0, NULL,
+                                          WRITE_COUNT_LONG, tx_buffer, WRITE_RSP_SIZE, rx_buffer);
+        if (ret_code != SHA204_SUCCESS) {
+            return false;
+        }
+    }
+    // Blocks 0 and 2 also hold read-only bytes, so changed words there are written one by one
+    for (int i=20; i < 84; i += 4) {
+        if ((i >= 32 && i < 64) || !(changed_words & ((uint32_t)1 << (i >> 2)))) {
+            continue;
+        }
+        ret_code = sha204.sha204m_execute(SHA204_WRITE, SHA204_ZONE_CONFIG,
+                                          i >> 2, SHA204_ZONE_ACCESS_4, &config[i], 0, NULL, 0, NULL,
+                                          WRITE_COUNT_SHORT, tx_buffer, WRITE_RSP_SIZE, rx_buffer);
+        if (ret_code != SHA204_SUCCESS) {
+            return false;
         }
     }
-    return crc;
+    // Nothing is read back: locking only succeeds if the zone matches the CRC of what was intended
+    return true;
 }
 #endif
 static bool get_atsha204a_serial(uint8_t* data)
@@ -894,6 +944,20 @@ static bool write_atsha204a_key(uint8_t* key)
     }
 }
 #endif // STORE_HMAC_KEY
+#ifdef BATCH_PROVISIONING
+static bool get_atsha204a_mac(uint8_t* challenge, uint8_t* mac)
+{
+    // MAC in mode 0: SHA-256 over the key in slot 0, the challenge and the command parameters
+    ret_code = sha204.sha204m_execute(SHA204_MAC, 0, 0, 32, challenge, 0, NULL, 0, NULL,
+                                      MAC_COUNT_LONG, tx_buffer, MAC_RSP_SIZE, rx_buffer);
+    if (ret_code != SHA204_SUCCESS) {
+        return false;
+    } else {
+        memcpy(mac, &rx_buffer[SHA204_BUFFER_POS_DATA], 32);
+        return true;
+    }
+}
+#endif // BATCH_PROVISIONING
 #endif // not USE_SOFT_SIGNING
 static void print_greeting(void)
 {
@@ -1249,21 +1313,7 @@ static void print_eeprom_data(void)
 static void print_whitelisting_entry(void)
 {
     uint8_t buffer[9];
-#ifdef USE_SOFT_SIGNING
-    unique_id_t uniqueID;
-    hwReadConfigBlock((void*)buffer, (void*)EEPROM_SIGNING_SOFT_SERIAL_ADDRESS, 9);
-    if (!memcmp(buffer, reset_buffer, 9)) {
-        // Serial reset in EEPROM, check for unique ID
-        if (hwUniqueID(&uniqueID)) {
-            memcpy(buffer, uniqueID, 9);
-        }
-    }
-#else
-    // If ATSHA204A is used, use that serial here
-    if (!get_atsha204a_serial(buffer)) {
-        memset(buffer, 0xFF, 9);
-    }
-#endif
+    get_whitelisting_serial(buffer);
     Serial.println(
         F("+------------------------------------------------------------------------------------+"));
     Serial.println(
@@ -1276,6 +1326,24 @@ static void print_whitelisting_entry(void)
     Serial.println(
         F("+------------------------------------------------------------------------------------+"));
 }
+static void get_whitelisting_serial(uint8_t* data)
+{
+#ifdef USE_SOFT_SIGNING
+    unique_id_t uniqueID;
+    hwReadConfigBlock((void*)data, (void*)EEPROM_SIGNING_SOFT_SERIAL_ADDRESS, 9);
+    if (!memcmp(data, reset_buffer, 9)) {
+        // Serial reset in EEPROM, check for unique ID
+        if (hwUniqueID(&uniqueID)) {
+            memcpy(data, uniqueID, 9);
+        }
+    }
+#else
+    // If ATSHA204A is used, use that serial here
+    if (!get_atsha204a_serial(data)) {
+        memset(data, 0xFF, 9);
+    }
+#endif
+}
 #ifdef PRINT_DETAILED_ATSHA204A_CONFIG
 static void dump_detailed_atsha204a_configuration(void)
 {
@@ -1629,6 +1697,196 @@ static void dump_detailed_atsha204a_configuration(void)
     }
 }
 #endif // PRINT_DETAILED_ATSHA204A_CONFIG
+#ifdef BATCH_PROVISIONING
+static void process_provisioning_input(void)
+{
+    while (Serial.available()) {
+        char c = Serial.read();
+        if (c == '\r') {
+            continue;
+        }
+        if (c != '\n') {
+            // Overlong lines are cut short and then fail to parse
+            if (provisioning_line_length < sizeof(provisioning_line) - 1) {
+                provisioning_line[provisioning_line_length++] = c;
+            }
+            continue;
+        }
+        provisioning_line[provisioning_line_length] = '\0';
+        provisioning_line_length = 0;
+        run_provisioning_command(provisioning_line);
+    }
+}
+static void run_provisioning_command(char* command)
+{
+    uint8_t buffer[32];
+    uint8_t* data = NULL;
+    size_t sz = 0;
+    char* verb = strtok(command, " ");
+    char* item = strtok(NULL, " ");
+    char* value = strtok(NULL, " ");
+#ifndef USE_SOFT_SIGNING
+    ret_code = SHA204_SUCCESS;
+#endif
+    if (verb == NULL) {
+        return;
+    }
+    // GEN and SET name the data they work on
+    if (item != NULL) {
+        if (!strcmp(item, "HMAC")) {
+            data = user_hmac_key;
+            sz = 32;
+        } else if (!strcmp(item, "AES")) {
+            data = user_aes_key;
+            sz = 16;
+        }
+#ifdef USE_SOFT_SIGNING
+        else if (!strcmp(item, "SERIAL")) {
+            data = user_soft_serial;
+            sz = 9;
+        }
+#endif
+    }
+
+    if (!strcmp(verb, "INFO")) {
+        unique_id_t uniqueID;
+        has_device_unique_id = hwUniqueID(&uniqueID);
+#ifdef USE_SOFT_SIGNING
+        get_whitelisting_serial(buffer);
+        Serial.print(F("OK SOFT "));
+        print_hex_buffer(buffer, 9);
+        Serial.println(has_device_unique_id ? F(" UNIQUE_ID") : F(" NO_UNIQUE_ID"));
+#else
+        // A chip that is already awake ignores the wake token, so only the read below counts
+        (void)sha204.sha204c_wakeup(rx_buffer);
+        if (!read_atsha204a_lock_state() || !get_atsha204a_serial(buffer)) {
+            reply_provisioning_error(F("DEVICE"));
+            return;
+        }
+        Serial.print(F("OK ATSHA204A "));
+        print_hex_buffer(buffer, 9);
+        Serial.println(lockConfig == 0x00 ? F(" LOCKED") : F(" UNLOCKED"));
+#endif
+#ifndef USE_SOFT_SIGNING
+    } else if (!strcmp(verb, "LOCK")) {
+        uint16_t crc;
+        // Ask the device rather than trust what the last INFO saw, the chip may have been swapped
+        if (!read_atsha204a_lock_state()) {
+            reply_provisioning_error(F("DEVICE"));
+            return;
+        }
+        if (lockConfig != 0x00 &&
+                (!write_atsha204a_config_and_get_crc(&crc) || !lock_atsha204a_config_zone(crc))) {
+            reply_provisioning_error(F("LOCK"));
+            return;
+        }
+        Serial.println(F("OK"));
+    } else if (!strcmp(verb, "MAC")) {
+        // The key in slot 0 cannot be read back, so the host checks it through a MAC instead
+        if (item == NULL || !parse_hex_buffer(item, buffer, 32)) {
+            reply_provisioning_error(F("VALUE"));
+            return;
+        }
+        if (!get_atsha204a_mac(buffer, buffer)) {
+            reply_provisioning_error(F("MAC"));
+            return;
+        }
+        Serial.print(F("OK "));
+        print_hex_buffer(buffer, 32);
+        Serial.println();
+#endif
+    } else if (!strcmp(verb, "GEN") && data != NULL) {
+        if (!generate_random_data(data, sz)) {
+            reply_provisioning_error(F("GEN"));
+            return;
+        }
+        Serial.print(F("OK "));
+        print_hex_buffer(data, sz);
+        Serial.println();
+    } else if (!strcmp(verb, "SET") && data != NULL) {
+        bool stored;
+        if (value == NULL || !parse_hex_buffer(value, buffer, sz)) {
+            reply_provisioning_error(F("VALUE"));
+            return;
+        }
+        memcpy(data, buffer, sz);
+        if (data == user_hmac_key) {
+            stored = store_hmac_key_data(data);
+        } else if (data == user_aes_key) {
+            stored = store_aes_key_data(data);
+        } else {
+#ifdef USE_SOFT_SIGNING
+            stored = store_soft_serial_data(data);
+#else
+            stored = false;
+#endif
+        }
+        if (!stored) {
+            reply_provisioning_error(F("STORE"));
+            return;
+        }
+        Serial.println(F("OK"));
+    } else if (!strcmp(verb, "CHECKSUM")) {
+        write_eeprom_checksum();
+        hwReadConfigBlock((void*)buffer, (void*)EEPROM_PERSONALIZATION_CHECKSUM_ADDRESS, 1);
+        Serial.print(F("OK "));
+        print_hex_buffer(buffer, 1);
+        Serial.println();
+    } else if (!strcmp(verb, "DUMP")) {
+        Serial.print(F("OK "));
+        hwReadConfigBlock((void*)buffer, (void*)EEPROM_SIGNING_SOFT_HMAC_KEY_ADDRESS, 32);
+        print_hex_buffer(buffer, 32);
+        Serial.print(' ');
+        hwReadConfigBlock((void*)buffer, (void*)EEPROM_RF_ENCRYPTION_AES_KEY_ADDRESS, 16);
+        print_hex_buffer(buffer, 16);
+        Serial.print(' ');
+        hwReadConfigBlock((void*)buffer, (void*)EEPROM_SIGNING_SOFT_SERIAL_ADDRESS, 9);
+        print_hex_buffer(buffer, 9);
+        Serial.print(' ');
+        hwReadConfigBlock((void*)buffer, (void*)EEPROM_PERSONALIZATION_CHECKSUM_ADDRESS, 1);
+        print_hex_buffer(buffer, 1);
+        Serial.println();
+    } else {
+        reply_provisioning_error(F("COMMAND"));
+    }
+}
+static bool parse_hex_buffer(const char* hex, uint8_t* data, size_t sz)
+{
+    if (strlen(hex) != 2 * sz) {
+        return false;
+    }
+    for (size_t i = 0; i < 2 * sz; i++) {
+        uint8_t nibble;
+        if (hex[i] >= '0' && hex[i] <= '9') {
+            nibble = hex[i] - '0';
+        } else if (hex[i] >= 'A' && hex[i] <= 'F') {
+            nibble = hex[i] - 'A' + 10;
+        } else if (hex[i] >= 'a' && hex[i] <= 'f') {
+            nibble = hex[i] - 'a' + 10;
+        } else {
+            return false;
+        }
+        if (i % 2 == 0) {
+            data[i / 2] = nibble << 4;
+        } else {
+            data[i / 2] |= nibble;
+        }
+    }
+    return true;
+}
+static void reply_provisioning_error(const __FlashStringHelper* reason)
+{
+    Serial.print(F("ERR "));
+    Serial.print(reason);
+#ifndef USE_SOFT_SIGNING
+    if (ret_code != SHA204_SUCCESS) {
+        Serial.print(' ');
+        print_hex_buffer(&ret_code, 1);
+    }
+#endif
+    Serial.println();
+}
+#endif // BATCH_PROVISIONING
 // Doxygen specific constructs, not included when built normally
 // This is used to enable disabled macros/definitions to be included in the documentation as well.
 #if DOXYGEN
@@ -1648,4 +1906,5 @@ static void dump_detailed_atsha204a_configuration(void)
 #define STORE_SOFT_SERIAL
 #define PRINT_DETAILED_ATSHA204A_CONFIG
 #define RESET_EEPROM_PERSONALIZATION
+#define BATCH_PROVISIONING
 #endif
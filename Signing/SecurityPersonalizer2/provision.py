@@ -0,0 +1,174 @@
+#!/usr/bin/env python3
+"""Batch provisioning for SecurityPersonalizer2.ino built with BATCH_PROVISIONING.
+
+Provisions devices one after the other with the same HMAC and AES keys, verifies what
+each device reports back and appends a line per device to a CSV log. Keys are taken
+from the command line or, if not given, generated by the first device.
+
+ATSHA204A chips are provisioned in a socket on one personalizer, so only what ends up on
+the chip is handled: the configuration lock and the HMAC key, checked by MAC. The AES key,
+soft serial and checksum live in the EEPROM of the board running the sketch and are only
+provisioned with --soft.
+
+Requires pyserial (pip install pyserial).
+
+  python3 provision.py --port /dev/ttyUSB0 --log provisioned.csv
+  python3 provision.py --port /dev/ttyUSB0 --hmac-key <64 hex digits> --aes-key <32 hex digits>
+  python3 provision.py --port /dev/ttyUSB0 --soft --random-serial
+"""
+
+import argparse
+import csv
+import datetime
+import hashlib
+import os
+import sys
+
+import serial
+
+BAUD_RATE = 115200
+READY_TIMEOUT = 10
+COMMAND_TIMEOUT = 10
+
+
+class ProvisioningError(Exception):
+    pass
+
+
+class Personalizer:
+    def __init__(self, port):
+        # Opening the port resets most boards, so wait for the sketch to come up
+        self.serial = serial.Serial(port, BAUD_RATE, timeout=READY_TIMEOUT)
+        while True:
+            line = self.serial.readline()
+            if not line:
+                raise ProvisioningError("personalizer did not report READY")
+            if line.strip() == b"READY":
+                break
+        self.serial.timeout = COMMAND_TIMEOUT
+
+    def close(self):
+        self.serial.close()
+
+    def command(self, command):
+        self.serial.write(command.encode("ascii") + b"\n")
+        line = self.serial.readline().decode("ascii", "replace").strip()
+        if not line:
+            raise ProvisioningError("%s: no response" % command.split()[0])
+        words = line.split()
+        if words[0] != "OK":
+            raise ProvisioningError("%s: %s" % (command.split()[0], line))
+        return words[1:]
+
+
+def eeprom_checksum(hmac_key, aes_key, soft_serial):
+    # Same as write_eeprom_checksum(): first byte of the SHA-256 of the EEPROM data
+    return hashlib.sha256(
+        bytes.fromhex(hmac_key) + bytes.fromhex(aes_key) + bytes.fromhex(soft_serial)
+    ).hexdigest()[:2].upper()
+
+
+def atsha204a_mac(key, challenge, serial_number):
+    # What the ATSHA204A MAC command hashes in mode 0 with the key in slot 0: the key, the
+    # challenge, opcode, mode and key ID, zeros in place of the OTP bytes and the serial
+    # number bytes that mode leaves out, and SN[8] and SN[0:1]
+    sn = bytes.fromhex(serial_number)
+    message = (bytes.fromhex(key) + challenge + bytes([0x08, 0x00, 0x00, 0x00]) + bytes(11)
+               + sn[8:9] + bytes(4) + sn[0:2] + bytes(2))
+    return hashlib.sha256(message).hexdigest().upper()
+
+
+def provision(personalizer, args, keys):
+    info = personalizer.command("INFO")
+    backend, serial_number = info[0], info[1]
+    if (backend == "SOFT") != args.soft:
+        raise ProvisioningError("personalizer was built for %s" % backend)
+
+    if backend == "ATSHA204A" and info[2] == "UNLOCKED":
+        personalizer.command("LOCK")
+
+    # The first device generates the keys unless they were given
+    for name in ("HMAC", "AES") if args.soft else ("HMAC",):
+        if keys[name] is None:
+            keys[name] = personalizer.command("GEN %s" % name)[0]
+            print("Generated %s key: %s" % (name, keys[name]))
+        personalizer.command("SET %s %s" % (name, keys[name]))
+
+    if not args.soft:
+        # The key slot cannot be read, so check that the chip computes the MAC the key would
+        challenge = os.urandom(32)
+        response = personalizer.command("MAC %s" % challenge.hex().upper())[0]
+        if response != atsha204a_mac(keys["HMAC"], challenge, serial_number):
+            raise ProvisioningError("HMAC key MAC mismatch")
+        return backend, serial_number
+
+    if args.random_serial:
+        if info[2] == "UNIQUE_ID":
+            print("Device has a unique ID, not storing a soft serial")
+        else:
+            serial_number = personalizer.command("GEN SERIAL")[0]
+            personalizer.command("SET SERIAL %s" % serial_number)
+
+    checksum = personalizer.command("CHECKSUM")[0]
+
+    # Verify what ended up in EEPROM
+    hmac_key, aes_key, soft_serial, stored_checksum = personalizer.command("DUMP")
+    if aes_key != keys["AES"]:
+        raise ProvisioningError("AES key readback mismatch")
+    if hmac_key != keys["HMAC"]:
+        raise ProvisioningError("HMAC key readback mismatch")
+    if args.random_serial and info[2] != "UNIQUE_ID" and soft_serial != serial_number:
+        raise ProvisioningError("soft serial readback mismatch")
+    if stored_checksum != checksum or checksum != eeprom_checksum(hmac_key, aes_key, soft_serial):
+        raise ProvisioningError("EEPROM checksum mismatch")
+
+    return backend, serial_number
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--port", required=True, help="serial port of the personalizer")
+    parser.add_argument("--hmac-key", help="HMAC key as 64 hex digits")
+    parser.add_argument("--aes-key", help="AES key as 32 hex digits, only stored with --soft")
+    parser.add_argument("--soft", action="store_true", help="personalizer was built with USE_SOFT_SIGNING")
+    parser.add_argument("--random-serial", action="store_true",
+                        help="store a random soft serial on devices without a unique ID")
+    parser.add_argument("--log", default="provisioned.csv", help="CSV file to append results to")
+    args = parser.parse_args()
+
+    keys = {
+        "HMAC": args.hmac_key.upper() if args.hmac_key else None,
+        "AES": args.aes_key.upper() if args.aes_key else None,
+    }
+    provisioned = failed = 0
+    with open(args.log, "a", newline="") as log_file:
+        log = csv.writer(log_file)
+        while True:
+            answer = input("Connect the next device and press Enter (q to quit): ")
+            if answer.strip().lower() == "q":
+                break
+            backend, serial_number, result = "", "", "OK"
+            try:
+                personalizer = Personalizer(args.port)
+                try:
+                    backend, serial_number = provision(personalizer, args, keys)
+                finally:
+                    personalizer.close()
+                provisioned += 1
+            except (ProvisioningError, serial.SerialException) as error:
+                result = str(error)
+                failed += 1
+            print("%s %s: %s" % (backend or "?", serial_number or "?", result))
+            log.writerow([datetime.datetime.now().isoformat(timespec="seconds"), backend, serial_number, result])
+            log_file.flush()
+
+    print("%d device(s) provisioned, %d failed" % (provisioned, failed))
+    if keys["HMAC"] is not None:
+        print("#define MY_HMAC_KEY " + ",".join("0x" + keys["HMAC"][i:i + 2] for i in range(0, 64, 2)))
+    if keys["AES"] is not None:
+        print("#define MY_AES_KEY " + ",".join("0x" + keys["AES"][i:i + 2] for i in range(0, 32, 2)))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())